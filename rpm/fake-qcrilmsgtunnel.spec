@@ -35,6 +35,7 @@ rm -rf %{buildroot}
 install -d $RPM_BUILD_ROOT%{_unitdir}/graphical.target.wants/
 install -m 644 -D %{name}.service %{buildroot}%{_unitdir}/%{name}.service
 ln -s ../%{name}.service $RPM_BUILD_ROOT%{_unitdir}/graphical.target.wants/%{name}.service
+install -m 644 -D dbus/org.sailfishos.qcrilmsgtunnel.conf %{buildroot}%{_sysconfdir}/dbus-1/system.d/org.sailfishos.qcrilmsgtunnel.conf
 
 %preun
 systemctl daemon-reload || :
@@ -47,3 +48,4 @@ systemctl daemon-reload || :
 %{_sbindir}/%{name}
 %{_unitdir}/%{name}.service
 %{_unitdir}/graphical.target.wants/%{name}.service
+%config %{_sysconfdir}/dbus-1/system.d/org.sailfishos.qcrilmsgtunnel.conf
@@ -0,0 +1,230 @@
+/*
+ * Binary capture of raw OEM hook traffic
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#define _GNU_SOURCE /* mremap */
+
+#include "capture.h"
+
+#include <gutil_log.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+G_STATIC_ASSERT(sizeof(CaptureFileHeader) % CAPTURE_ALIGN == 0);
+G_STATIC_ASSERT(sizeof(CaptureRecordHeader) % CAPTURE_ALIGN == 0);
+
+#define CAPTURE_PAD(size)                                                      \
+  (((size) + CAPTURE_ALIGN - 1) & ~(gsize)(CAPTURE_ALIGN - 1))
+
+struct capture_writer {
+  char *path;
+  int fd;
+  guint8 *map;
+  gsize mapped;
+  gsize used; /* including the file header */
+  gint64 start;
+  gboolean failed;
+};
+
+struct capture_reader {
+  int fd;
+  const guint8 *map;
+  gsize mapped;
+  gsize end; /* of the records */
+  gsize pos;
+};
+
+// Blocks are reserved up front. Running out of space fails here instead of
+// raising SIGBUS on a later store into the mapping.
+static gboolean capture_writer_map(CaptureWriter *writer, gsize size) {
+  guint8 *map;
+  int err;
+
+  err = posix_fallocate(writer->fd, writer->mapped, size - writer->mapped);
+  if (err) {
+    GERR("Failed to grow %s: %s", writer->path, strerror(err));
+    return FALSE;
+  }
+
+  if (writer->map)
+    map = mremap(writer->map, writer->mapped, size, MREMAP_MAYMOVE);
+  else
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, writer->fd, 0);
+  if (map == MAP_FAILED) {
+    GERR("Failed to map %s: %s", writer->path, strerror(errno));
+    return FALSE;
+  }
+
+  writer->map = map;
+  writer->mapped = size;
+  return TRUE;
+}
+
+CaptureWriter *capture_writer_new(const char *path) {
+  CaptureWriter *writer = g_new0(CaptureWriter, 1);
+  CaptureFileHeader *header;
+
+  writer->path = g_strdup(path);
+  writer->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (writer->fd < 0) {
+    GERR("Failed to create %s: %s", path, strerror(errno));
+    g_free(writer->path);
+    g_free(writer);
+    return NULL;
+  }
+
+  if (!capture_writer_map(writer, CAPTURE_SEGMENT)) {
+    close(writer->fd);
+    unlink(path);
+    g_free(writer->path);
+    g_free(writer);
+    return NULL;
+  }
+
+  header = (CaptureFileHeader *)writer->map;
+  memcpy(header->magic, CAPTURE_MAGIC, sizeof(header->magic));
+  header->version = CAPTURE_VERSION;
+  header->header_size = sizeof(*header);
+  header->start = g_get_real_time();
+  header->length = 0;
+  writer->used = sizeof(*header);
+  writer->start = g_get_monotonic_time();
+  GINFO("Capturing to %s", path);
+  return writer;
+}
+
+void capture_writer_add(CaptureWriter *writer, CaptureKind kind, guint slot,
+                        gint32 serial, gint32 err, const void *data,
+                        gsize size, gint64 now) {
+  const gsize need = sizeof(CaptureRecordHeader) + CAPTURE_PAD(size);
+  CaptureRecordHeader *rec;
+
+  if (writer->failed || size > G_MAXUINT32)
+    return;
+
+  if (writer->used + need > writer->mapped &&
+      !capture_writer_map(writer,
+                          writer->mapped +
+                              MAX(CAPTURE_PAD(need), CAPTURE_SEGMENT))) {
+    GERR("Capture stopped");
+    writer->failed = TRUE;
+    return;
+  }
+
+  // the reserved blocks read as zeros, padding included
+  rec = (CaptureRecordHeader *)(writer->map + writer->used);
+  rec->size = size;
+  rec->kind = kind;
+  rec->slot = slot;
+  rec->serial = serial;
+  rec->err = err;
+  rec->time = now - writer->start;
+  if (size)
+    memcpy(rec + 1, data, size);
+
+  writer->used += need;
+  ((CaptureFileHeader *)writer->map)->length =
+      writer->used - sizeof(CaptureFileHeader);
+}
+
+void capture_writer_free(CaptureWriter *writer) {
+  if (!writer)
+    return;
+
+  munmap(writer->map, writer->mapped);
+  if (ftruncate(writer->fd, writer->used) < 0)
+    GWARN("Failed to trim %s: %s", writer->path, strerror(errno));
+  close(writer->fd);
+  g_free(writer->path);
+  g_free(writer);
+}
+
+CaptureReader *capture_reader_new(const char *path) {
+  const CaptureFileHeader *header;
+  CaptureReader *reader;
+  struct stat st;
+  void *map;
+  int fd;
+
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    GERR("Failed to open %s: %s", path, strerror(errno));
+    return NULL;
+  }
+
+  if (fstat(fd, &st) < 0 || (gsize)st.st_size < sizeof(*header)) {
+    GERR("%s is not a capture file", path);
+    close(fd);
+    return NULL;
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) {
+    GERR("Failed to map %s: %s", path, strerror(errno));
+    close(fd);
+    return NULL;
+  }
+
+  header = map;
+  if (memcmp(header->magic, CAPTURE_MAGIC, sizeof(header->magic)) ||
+      header->version != CAPTURE_VERSION ||
+      header->header_size < sizeof(*header) ||
+      header->header_size > (gsize)st.st_size) {
+    GERR("%s is not a version %d capture file", path, CAPTURE_VERSION);
+    munmap(map, st.st_size);
+    close(fd);
+    return NULL;
+  }
+
+  reader = g_new0(CaptureReader, 1);
+  reader->fd = fd;
+  reader->map = map;
+  reader->mapped = st.st_size;
+  reader->end = header->header_size +
+                MIN(header->length, reader->mapped - header->header_size);
+  reader->pos = header->header_size;
+  return reader;
+}
+
+gboolean capture_reader_next(CaptureReader *reader, CaptureRecord *record) {
+  const CaptureRecordHeader *rec;
+
+  if (reader->end - reader->pos < sizeof(*rec))
+    return FALSE;
+
+  rec = (const CaptureRecordHeader *)(reader->map + reader->pos);
+  if (rec->kind == CAPTURE_END ||
+      rec->size > reader->end - reader->pos - sizeof(*rec))
+    return FALSE;
+
+  record->kind = rec->kind;
+  record->slot = rec->slot;
+  record->serial = rec->serial;
+  record->err = rec->err;
+  record->time = rec->time;
+  record->data = (const guint8 *)(rec + 1);
+  record->size = rec->size;
+  reader->pos = MIN(reader->end,
+                    reader->pos + sizeof(*rec) + CAPTURE_PAD(rec->size));
+  return TRUE;
+}
+
+void capture_reader_rewind(CaptureReader *reader) {
+  reader->pos = ((const CaptureFileHeader *)reader->map)->header_size;
+}
+
+void capture_reader_free(CaptureReader *reader) {
+  if (!reader)
+    return;
+
+  munmap((void *)reader->map, reader->mapped);
+  close(reader->fd);
+  g_free(reader);
+}
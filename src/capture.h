@@ -0,0 +1,123 @@
+/*
+ * Binary capture of raw OEM hook traffic
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <glib.h>
+
+/*
+ * File layout, host byte order:
+ *
+ *   CaptureFileHeader
+ *   CaptureRecordHeader, payload, zero padding to CAPTURE_ALIGN
+ *   ...
+ *
+ * The writer maps the file and grows it by CAPTURE_SEGMENT at a time, so
+ * appending a record is a copy into memory. The blocks of each segment are
+ * reserved before it is mapped, a full file system stops the capture. The
+ * header keeps the length of the records written so far, anything past it
+ * is not part of the capture.
+ */
+#define CAPTURE_MAGIC "QHOOKCAP"
+#define CAPTURE_VERSION 1
+#define CAPTURE_ALIGN 8
+#define CAPTURE_SEGMENT (1024 * 1024)
+
+typedef enum capture_kind {
+  CAPTURE_END,        /* not written, zero filled tail */
+  CAPTURE_RESPONSE,   /* QCOM_HOOK_RESPONSE_RAW */
+  CAPTURE_INDICATION, /* QCOM_HOOK_INDICATION_RAW */
+} CaptureKind;
+
+typedef struct capture_file_header {
+  char magic[8];
+  guint32 version;
+  guint32 header_size;
+  gint64 start;   /* wall clock time of the start, us since the epoch */
+  guint64 length; /* bytes of records after the header */
+} CaptureFileHeader;
+
+typedef struct capture_record_header {
+  guint32 size; /* payload bytes */
+  guint8 kind;
+  guint8 slot;
+  guint16 reserved;
+  gint32 serial; /* responses */
+  gint32 err;    /* responses */
+  gint64 time;   /* us since the start of the capture */
+} CaptureRecordHeader;
+
+/* One record as seen by the reader, data points into the mapping */
+typedef struct capture_record {
+  CaptureKind kind;
+  guint slot;
+  gint32 serial;
+  gint32 err;
+  gint64 time;
+  const guint8 *data; /* CAPTURE_ALIGN aligned */
+  gsize size;
+} CaptureRecord;
+
+typedef struct capture_writer CaptureWriter;
+typedef struct capture_reader CaptureReader;
+
+/**
+ * Create capture file, replacing an existing one
+ * @param path: File name
+ * @return: Writer or NULL on failure
+ */
+CaptureWriter *capture_writer_new(const char *path);
+
+/**
+ * Append one message. Writing stops if the file can not be grown.
+ * @param writer: Writer
+ * @param kind: CAPTURE_RESPONSE or CAPTURE_INDICATION
+ * @param slot: SIM slot of the link
+ * @param serial: Response serial or 0
+ * @param err: Response error or 0
+ * @param data: Raw message (can be NULL)
+ * @param size: Message size in bytes
+ * @param now: Current monotonic time
+ */
+void capture_writer_add(CaptureWriter *writer, CaptureKind kind, guint slot,
+                        gint32 serial, gint32 err, const void *data,
+                        gsize size, gint64 now);
+
+/**
+ * Trim the file to the records written and close it
+ * @param writer: Writer (can be NULL)
+ */
+void capture_writer_free(CaptureWriter *writer);
+
+/**
+ * Map capture file for reading
+ * @param path: File name
+ * @return: Reader or NULL if the file is not a capture
+ */
+CaptureReader *capture_reader_new(const char *path);
+
+/**
+ * Get the next record
+ * @param reader: Reader
+ * @param record: Filled in, valid until the reader is freed
+ * @return: FALSE at the end of the capture
+ */
+gboolean capture_reader_next(CaptureReader *reader, CaptureRecord *record);
+
+/**
+ * Start again from the first record
+ * @param reader: Reader
+ */
+void capture_reader_rewind(CaptureReader *reader);
+
+/**
+ * Unmap the file
+ * @param reader: Reader (can be NULL)
+ */
+void capture_reader_free(CaptureReader *reader);
+
+#endif
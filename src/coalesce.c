@@ -0,0 +1,83 @@
+/*
+ * Coalescing of triggers for an operation that is done once per key
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "coalesce.h"
+
+#include <gutil_log.h>
+
+#include <string.h>
+
+static gboolean coalescer_flush(gpointer user_data) {
+  Coalescer *coalescer = user_data;
+  const guint triggers = coalescer->triggers;
+  const guint64 key = coalescer->key;
+
+  coalescer->idle_id = 0;
+  coalescer->triggers = 0;
+
+  if ((coalescer->busy && coalescer->busy_key == key) ||
+      coalescer_is_done(coalescer, key)) {
+    coalescer->suppressed += triggers;
+    GDEBUG("%s: %s %s, %u trigger(s) suppressed (%" G_GUINT64_FORMAT
+           " in total)",
+           coalescer->owner, coalescer->op,
+           coalescer->busy ? "in flight" : "done already", triggers,
+           coalescer->suppressed);
+    return G_SOURCE_REMOVE;
+  }
+
+  coalescer->suppressed += triggers - 1;
+  if (triggers > 1)
+    GDEBUG("%s: %u %s triggers coalesced", coalescer->owner, triggers,
+           coalescer->op);
+
+  coalescer->busy = TRUE;
+  coalescer->busy_key = key;
+  if (coalescer->func(coalescer->user_data))
+    coalescer->performed++;
+  else if (coalescer->busy_key == key)
+    // nothing in flight, the next trigger must not be suppressed
+    coalescer->busy = FALSE;
+  return G_SOURCE_REMOVE;
+}
+
+void coalescer_init(Coalescer *coalescer, const char *owner, const char *op,
+                    CoalescerFunc func, gpointer user_data) {
+  memset(coalescer, 0, sizeof(*coalescer));
+  coalescer->owner = owner;
+  coalescer->op = op;
+  coalescer->func = func;
+  coalescer->user_data = user_data;
+}
+
+void coalescer_trigger(Coalescer *coalescer, guint64 key) {
+  coalescer->triggers++;
+  coalescer->key = key;
+  if (!coalescer->idle_id)
+    coalescer->idle_id = g_idle_add(coalescer_flush, coalescer);
+}
+
+void coalescer_complete(Coalescer *coalescer, guint64 key, gboolean ok) {
+  if (coalescer->busy && coalescer->busy_key == key)
+    coalescer->busy = FALSE;
+  if (ok) {
+    coalescer->done = TRUE;
+    coalescer->done_key = key;
+  }
+}
+
+gboolean coalescer_is_done(const Coalescer *coalescer, guint64 key) {
+  return coalescer->done && coalescer->done_key == key;
+}
+
+void coalescer_cancel(Coalescer *coalescer) {
+  if (coalescer->idle_id) {
+    g_source_remove(coalescer->idle_id);
+    coalescer->idle_id = 0;
+  }
+  coalescer->triggers = 0;
+  coalescer->busy = FALSE;
+}
@@ -0,0 +1,81 @@
+/*
+ * Coalescing of triggers for an operation that is done once per key
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef COALESCE_H
+#define COALESCE_H
+
+#include <glib.h>
+
+/**
+ * Perform the operation, its outcome is reported with coalescer_complete()
+ * @param user_data: User data passed to coalescer_init()
+ * @return: TRUE if the operation has been started, FALSE if there was
+ * nothing to do after all
+ */
+typedef gboolean (*CoalescerFunc)(gpointer user_data);
+
+/*
+ * Triggers within one main loop iteration are flushed together. A flush
+ * performs the operation unless it is in flight or has been completed for
+ * the key of the last trigger. Everything else counts as suppressed.
+ */
+typedef struct coalescer {
+  const char *owner;
+  const char *op;
+  CoalescerFunc func;
+  gpointer user_data;
+  guint idle_id;
+  guint triggers; /* since the last flush */
+  guint64 key;    /* of the last trigger */
+  gboolean busy;
+  guint64 busy_key;
+  gboolean done;
+  guint64 done_key;
+  guint64 performed; /* flushes that started the operation */
+  guint64 suppressed;
+} Coalescer;
+
+/**
+ * Initialize coalescer
+ * @param coalescer: Coalescer to initialize
+ * @param owner: Instance name for logging, not copied
+ * @param op: Operation name for logging, not copied
+ * @param func: Operation
+ * @param user_data: User data passed to func
+ */
+void coalescer_init(Coalescer *coalescer, const char *owner, const char *op,
+                    CoalescerFunc func, gpointer user_data);
+
+/**
+ * Request the operation for the key, it is flushed from an idle callback
+ * @param coalescer: Coalescer
+ * @param key: Identifies what the operation is done for
+ */
+void coalescer_trigger(Coalescer *coalescer, guint64 key);
+
+/**
+ * Operation has completed, whether performed by a flush or by a retry
+ * @param coalescer: Coalescer
+ * @param key: Key the operation was performed for
+ * @param ok: TRUE if it does not need to be repeated for the key
+ */
+void coalescer_complete(Coalescer *coalescer, guint64 key, gboolean ok);
+
+/**
+ * @param coalescer: Coalescer
+ * @param key: Key to check
+ * @return: TRUE if the operation has been completed for the key
+ */
+gboolean coalescer_is_done(const Coalescer *coalescer, guint64 key);
+
+/**
+ * Drop pending flush and forget what is in flight, e.g. when the remote
+ * has died. Counters are kept.
+ * @param coalescer: Coalescer
+ */
+void coalescer_cancel(Coalescer *coalescer);
+
+#endif
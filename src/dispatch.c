@@ -0,0 +1,66 @@
+/*
+ * Dispatch of QCRIL OEM hook indications by resp_id
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "dispatch.h"
+
+#define DISPATCH_INDEX(id) ((guint32)((id) - QCRIL_EVT_HOOK_UNSOL_BASE))
+#define DISPATCH_VALID(id) (DISPATCH_INDEX(id) < OEM_HOOK_DISPATCH_SIZE)
+
+static const char *const oem_hook_ind_names[OEM_HOOK_DISPATCH_SIZE] = {
+    [DISPATCH_INDEX(525299)] = "IncrNwScanInd",
+    [DISPATCH_INDEX(525300)] = "EngineerMode",
+    [DISPATCH_INDEX(525302)] = "DeviceConfig",
+    [DISPATCH_INDEX(525303)] = "AudioStateChanged",
+    [DISPATCH_INDEX(525305)] = "ClearConfigs",
+    [DISPATCH_INDEX(525311)] = "ValidateConfigs",
+    [DISPATCH_INDEX(525312)] = "ValidateDumped",
+    [DISPATCH_INDEX(525320)] = "PdcConfigsList",
+    [DISPATCH_INDEX(525322)] = "AdnInitDone",
+    [DISPATCH_INDEX(525323)] = "AdnRecordsInd",
+    [DISPATCH_INDEX(525340)] = "CsgChangedInd",
+    [DISPATCH_INDEX(525341)] = "RacChange",
+};
+
+void oem_hook_dispatch_init(OemHookDispatch *dispatch) {
+  memset(dispatch, 0, sizeof(*dispatch));
+}
+
+gboolean oem_hook_dispatch_register(OemHookDispatch *dispatch, gint32 resp_id,
+                                    OemHookIndHandler handler,
+                                    gpointer user_data) {
+  if (!DISPATCH_VALID(resp_id))
+    return FALSE;
+
+  OemHookIndEntry *entry = dispatch->entries + DISPATCH_INDEX(resp_id);
+  entry->handler = handler;
+  entry->user_data = handler ? user_data : NULL;
+  return TRUE;
+}
+
+gboolean oem_hook_dispatch(OemHookDispatch *dispatch, gint32 resp_id,
+                           const void *data, gsize size, gpointer context) {
+  const OemHookIndEntry *entry =
+      DISPATCH_VALID(resp_id) ? dispatch->entries + DISPATCH_INDEX(resp_id)
+                              : NULL;
+
+  // fast path for anything nobody has registered for
+  if (!entry || !entry->handler) {
+    dispatch->unhandled++;
+    return FALSE;
+  }
+
+  dispatch->dispatched++;
+  entry->handler(resp_id, data, size, context, entry->user_data);
+  return TRUE;
+}
+
+const char *oem_hook_ind_name(gint32 resp_id) {
+  const char *name =
+      DISPATCH_VALID(resp_id) ? oem_hook_ind_names[DISPATCH_INDEX(resp_id)]
+                              : NULL;
+
+  return name ? name : "";
+}
@@ -0,0 +1,80 @@
+/*
+ * Dispatch of QCRIL OEM hook indications by resp_id
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <glib.h>
+
+/*
+ * Unsolicited OEM hook events are numbered from QCRIL_EVT_HOOK_UNSOL_BASE
+ * upwards. The table is indexed by the offset from the base, so lookup is a
+ * range check and an array access regardless of the number of known IDs.
+ */
+#define QCRIL_EVT_HOOK_UNSOL_BASE 525288
+#define OEM_HOOK_DISPATCH_SIZE 128
+
+/**
+ * Indication handler
+ * @param resp_id: Indication ID
+ * @param data: Payload, valid only during the call
+ * @param size: Payload size in bytes
+ * @param context: Context passed to oem_hook_dispatch()
+ * @param user_data: User data passed to oem_hook_dispatch_register()
+ */
+typedef void (*OemHookIndHandler)(gint32 resp_id, const void *data,
+                                  gsize size, gpointer context,
+                                  gpointer user_data);
+
+typedef struct oem_hook_ind_entry {
+  OemHookIndHandler handler;
+  gpointer user_data;
+} OemHookIndEntry;
+
+typedef struct oem_hook_dispatch {
+  OemHookIndEntry entries[OEM_HOOK_DISPATCH_SIZE];
+  guint64 dispatched;
+  guint64 unhandled;
+} OemHookDispatch;
+
+/**
+ * Initialize dispatch table without any handlers
+ * @param dispatch: Table to initialize
+ */
+void oem_hook_dispatch_init(OemHookDispatch *dispatch);
+
+/**
+ * Register handler for specific indication, replacing the previous one
+ * @param dispatch: Dispatch table
+ * @param resp_id: Indication ID
+ * @param handler: Handler to call, NULL to unregister
+ * @param user_data: User data passed to handler
+ * @return: FALSE if resp_id is outside of the table range
+ */
+gboolean oem_hook_dispatch_register(OemHookDispatch *dispatch, gint32 resp_id,
+                                    OemHookIndHandler handler,
+                                    gpointer user_data);
+
+/**
+ * Call handler registered for the indication
+ * @param dispatch: Dispatch table
+ * @param resp_id: Indication ID
+ * @param data: Payload
+ * @param size: Payload size in bytes
+ * @param context: Passed to handler, e.g. the receiving slot
+ * @return: TRUE if handler was called
+ */
+gboolean oem_hook_dispatch(OemHookDispatch *dispatch, gint32 resp_id,
+                           const void *data, gsize size, gpointer context);
+
+/**
+ * Name of known indication
+ * @param resp_id: Indication ID
+ * @return: Name or empty string if not known
+ */
+const char *oem_hook_ind_name(gint32 resp_id);
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * Rate limiting of payload hex dumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "dumplimit.h"
+
+static gboolean dump_limiter_take_bucket(DumpLimiter *limiter,
+                                        DumpBucket *bucket, gint64 now,
+                                        guint *suppressed) {
+  const gint64 refill = DUMP_REFILL_SEC * G_TIME_SPAN_SECOND;
+
+  if (!bucket->stamp) {
+    // first use
+    bucket->tokens = DUMP_BURST;
+  } else if (bucket->tokens < DUMP_BURST) {
+    const gint64 add = (now - bucket->stamp) / refill;
+    bucket->tokens = MIN(DUMP_BURST, bucket->tokens + add);
+    bucket->stamp += add * refill;
+  }
+
+  if (!bucket->tokens) {
+    bucket->suppressed++;
+    limiter->suppressed++;
+    return FALSE;
+  }
+
+  // refill period starts with the first token taken from a full bucket
+  if (bucket->tokens == DUMP_BURST)
+    bucket->stamp = now;
+  bucket->tokens--;
+
+  *suppressed = bucket->suppressed;
+  bucket->suppressed = 0;
+  limiter->dumped++;
+  return TRUE;
+}
+
+gboolean dump_limiter_take(DumpLimiter *limiter, gint32 resp_id, gint64 now,
+                           guint *suppressed) {
+  const guint32 index = (guint32)(resp_id - QCRIL_EVT_HOOK_UNSOL_BASE);
+
+  return dump_limiter_take_bucket(
+      limiter,
+      limiter->buckets +
+          (index < OEM_HOOK_DISPATCH_SIZE ? index : DUMP_BUCKET_OTHER),
+      now, suppressed);
+}
+
+gboolean dump_limiter_take_response(DumpLimiter *limiter, gint64 now,
+                                    guint *suppressed) {
+  return dump_limiter_take_bucket(
+      limiter, limiter->buckets + DUMP_BUCKET_RESPONSE, now, suppressed);
+}
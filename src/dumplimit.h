@@ -0,0 +1,61 @@
+/*
+ * Rate limiting of payload hex dumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef DUMPLIMIT_H
+#define DUMPLIMIT_H
+
+#include "dispatch.h"
+
+// Payload hex dumps are always done at verbose level. Otherwise each
+// resp_id may dump DUMP_BURST payloads, refilled by one every
+// DUMP_REFILL_SEC seconds.
+#define DUMP_MAX_BYTES 256
+#define DUMP_BURST 4
+#define DUMP_REFILL_SEC 10
+
+typedef struct dump_bucket {
+  gint64 stamp; /* last refill, monotonic */
+  guint tokens;
+  guint suppressed; /* since last dump */
+} DumpBucket;
+
+// Buckets past the unsolicited IDs
+#define DUMP_BUCKET_RESPONSE OEM_HOOK_DISPATCH_SIZE
+#define DUMP_BUCKET_OTHER (OEM_HOOK_DISPATCH_SIZE + 1)
+
+typedef struct dump_limiter {
+  /* unsolicited IDs by offset from the base, then responses and the rest */
+  DumpBucket buckets[DUMP_BUCKET_OTHER + 1];
+  guint64 dumped;
+  guint64 suppressed;
+} DumpLimiter;
+
+/**
+ * Take a token for dumping payload of the given ID
+ * @param limiter: Rate limiter
+ * @param resp_id: Indication ID, anything out of the unsolicited range
+ * shares one bucket
+ * @param now: Current monotonic time
+ * @param suppressed: Set to the number of dumps suppressed for this ID
+ * since the previous allowed one
+ * @return: TRUE if the dump may be done
+ */
+gboolean dump_limiter_take(DumpLimiter *limiter, gint32 resp_id, gint64 now,
+                           guint *suppressed);
+
+/**
+ * Take a token for dumping response payload. Responses have a bucket of
+ * their own.
+ * @param limiter: Rate limiter
+ * @param now: Current monotonic time
+ * @param suppressed: Set to the number of response dumps suppressed since
+ * the previous allowed one
+ * @return: TRUE if the dump may be done
+ */
+gboolean dump_limiter_take_response(DumpLimiter *limiter, gint64 now,
+                                    guint *suppressed);
+
+#endif
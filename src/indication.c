@@ -0,0 +1,172 @@
+/*
+ * Typed views over the payload of known QCRIL OEM hook indications
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "indication.h"
+
+#include <gutil_log.h>
+
+#include <string.h>
+
+// memcpy with constant size compiles into a plain (unaligned) load
+static inline guint16 load_uint16(const guint8 *ptr) {
+  guint16 value;
+
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+// Takes a 16-bit length and that many bytes, FALSE if they do not fit
+static gboolean take_string(const guint8 **ptr, const guint8 *end,
+                            OemHookBytes *str) {
+  guint16 len;
+
+  if ((gsize)(end - *ptr) < sizeof(len))
+    return FALSE;
+  len = load_uint16(*ptr);
+  *ptr += sizeof(len);
+  if ((gsize)(end - *ptr) < len)
+    return FALSE;
+
+  str->data = len ? *ptr : NULL;
+  str->size = len;
+  *ptr += len;
+  return TRUE;
+}
+
+// Takes a 16-bit count and that many strings, FALSE if they do not fit
+static gboolean take_strings(const guint8 **ptr, const guint8 *end,
+                             OemHookStringIter *iter) {
+  guint16 count;
+  OemHookBytes skip;
+
+  if ((gsize)(end - *ptr) < sizeof(count))
+    return FALSE;
+  count = load_uint16(*ptr);
+  *ptr += sizeof(count);
+
+  iter->ptr = *ptr;
+  iter->remaining = count;
+  for (guint i = 0; i < count; i++) {
+    if (!take_string(ptr, end, &skip))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+gboolean adn_records_iter_init(AdnRecordsIter *iter, const void *data,
+                               gsize size) {
+  const guint8 *ptr = data;
+
+  memset(iter, 0, sizeof(*iter));
+  if (!ptr || size < sizeof(guint16))
+    return FALSE;
+
+  iter->count = iter->remaining = load_uint16(ptr);
+  iter->ptr = ptr + sizeof(guint16);
+  iter->end = ptr + size;
+  return TRUE;
+}
+
+// One record, FALSE if it does not fit in the rest of the payload
+static gboolean adn_records_take(AdnRecordsIter *iter, AdnRecord *record) {
+  const guint8 *ptr = iter->ptr;
+
+  if ((gsize)(iter->end - ptr) < sizeof(guint16))
+    return FALSE;
+  record->index = load_uint16(ptr);
+  ptr += sizeof(guint16);
+
+  if (!take_string(&ptr, iter->end, &record->name) ||
+      !take_string(&ptr, iter->end, &record->number) ||
+      !take_strings(&ptr, iter->end, &record->emails) ||
+      !take_strings(&ptr, iter->end, &record->anrs))
+    return FALSE;
+
+  iter->ptr = ptr;
+  return TRUE;
+}
+
+gboolean adn_records_iter_next(AdnRecordsIter *iter, AdnRecord *record) {
+  if (!iter->remaining)
+    return FALSE;
+
+  if (!adn_records_take(iter, record)) {
+    iter->malformed = TRUE;
+    iter->remaining = 0;
+    return FALSE;
+  }
+
+  iter->remaining--;
+  return TRUE;
+}
+
+gboolean oem_hook_string_iter_next(OemHookStringIter *iter,
+                                   OemHookBytes *str) {
+  guint16 len;
+
+  if (!iter->remaining)
+    return FALSE;
+
+  // the range has been checked by take_strings()
+  len = load_uint16(iter->ptr);
+  str->data = len ? iter->ptr + sizeof(len) : NULL;
+  str->size = len;
+  iter->ptr += sizeof(len) + len;
+  iter->remaining--;
+  return TRUE;
+}
+
+gboolean csg_changed_ind_decode(const void *data, gsize size,
+                                gint32 *csg_id) {
+  if (!data || size < sizeof(*csg_id))
+    return FALSE;
+
+  memcpy(csg_id, data, sizeof(*csg_id));
+  return TRUE;
+}
+
+// AdnRecordsInd, walked in place however large the batch is
+static void adn_records_ind(gint32 resp_id, const void *data, gsize size,
+                            gpointer context, gpointer user_data) {
+  AdnRecordsIter iter;
+  AdnRecord record;
+  guint n = 0;
+
+  if (!adn_records_iter_init(&iter, data, size)) {
+    GWARN("AdnRecordsInd too short, %zu bytes", size);
+    return;
+  }
+
+  while (adn_records_iter_next(&iter, &record)) {
+    GDEBUG("ADN record %u: name %zu bytes, number %zu bytes, %u email(s), "
+           "%u additional number(s)",
+           record.index, record.name.size, record.number.size,
+           record.emails.remaining, record.anrs.remaining);
+    n++;
+  }
+
+  if (iter.malformed)
+    GWARN("AdnRecordsInd malformed after %u of %u records", n, iter.count);
+  else
+    GINFO("%u ADN records", n);
+}
+
+static void csg_changed_ind(gint32 resp_id, const void *data, gsize size,
+                            gpointer context, gpointer user_data) {
+  gint32 csg_id;
+
+  if (csg_changed_ind_decode(data, size, &csg_id))
+    GINFO("CSG id changed to %d", csg_id);
+  else
+    GWARN("CsgChangedInd too short, %zu bytes", size);
+}
+
+void oem_hook_register_decoders(OemHookDispatch *dispatch) {
+  oem_hook_dispatch_register(dispatch, QCRIL_EVT_HOOK_UNSOL_ADN_RECORDS_IND,
+                             adn_records_ind, NULL);
+  oem_hook_dispatch_register(dispatch, QCRIL_EVT_HOOK_UNSOL_CSG_ID_CHANGE_IND,
+                             csg_changed_ind, NULL);
+}
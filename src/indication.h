@@ -0,0 +1,106 @@
+/*
+ * Typed views over the payload of known QCRIL OEM hook indications
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef INDICATION_H
+#define INDICATION_H
+
+#include "dispatch.h"
+
+#include <glib.h>
+
+#define QCRIL_EVT_HOOK_UNSOL_ADN_INIT_DONE 525322
+#define QCRIL_EVT_HOOK_UNSOL_ADN_RECORDS_IND 525323
+#define QCRIL_EVT_HOOK_UNSOL_CSG_ID_CHANGE_IND 525340
+
+/*
+ * Nothing is copied or allocated. Views point into the payload and are
+ * valid as long as it is. Integers are in host byte order and are not
+ * necessarily aligned, strings are not NUL terminated.
+ */
+typedef struct oem_hook_bytes {
+  const guint8 *data;
+  gsize size;
+} OemHookBytes;
+
+/*
+ * Count prefixed list of length prefixed strings, both 16-bit. Only made
+ * for ranges that have been checked already, so iterating can not fail.
+ */
+typedef struct oem_hook_string_iter {
+  const guint8 *ptr;
+  guint remaining;
+} OemHookStringIter;
+
+/*
+ * AdnRecordsInd payload:
+ *   count
+ *   count times:
+ *     index, name length, name, number length, number,
+ *     email count, (length, email) * email count,
+ *     anr count, (length, anr) * anr count
+ * All counts, lengths and indexes are 16-bit.
+ */
+typedef struct adn_record {
+  guint16 index;
+  OemHookBytes name; /* as stored on the SIM */
+  OemHookBytes number;
+  OemHookStringIter emails;
+  OemHookStringIter anrs; /* additional numbers */
+} AdnRecord;
+
+typedef struct adn_records_iter {
+  const guint8 *ptr;
+  const guint8 *end;
+  guint count;     /* records announced by the payload */
+  guint remaining; /* not yet returned */
+  gboolean malformed;
+} AdnRecordsIter;
+
+/**
+ * Start iterating AdnRecordsInd payload
+ * @param iter: Iterator to initialize
+ * @param data: Payload
+ * @param size: Payload size in bytes
+ * @return: FALSE if the payload is too short for the record count
+ */
+gboolean adn_records_iter_init(AdnRecordsIter *iter, const void *data,
+                               gsize size);
+
+/**
+ * Next record. A record that does not fit in the payload ends the
+ * iteration and sets malformed.
+ * @param iter: Iterator
+ * @param record: View over the record, valid as long as the payload is
+ * @return: FALSE if there are no more records
+ */
+gboolean adn_records_iter_next(AdnRecordsIter *iter, AdnRecord *record);
+
+/**
+ * Next string of a record's list
+ * @param iter: String iterator of the record
+ * @param str: View over the string
+ * @return: FALSE if there are no more strings
+ */
+gboolean oem_hook_string_iter_next(OemHookStringIter *iter,
+                                   OemHookBytes *str);
+
+/**
+ * Decode CsgChangedInd payload, a 32-bit CSG id
+ * @param data: Payload
+ * @param size: Payload size in bytes
+ * @param csg_id: Decoded id
+ * @return: FALSE if the payload is too short
+ */
+gboolean csg_changed_ind_decode(const void *data, gsize size, gint32 *csg_id);
+
+/**
+ * Register the handlers that decode and log AdnRecordsInd and
+ * CsgChangedInd. They do not use the dispatch context.
+ * @param dispatch: Dispatch table
+ */
+void oem_hook_register_decoders(OemHookDispatch *dispatch);
+
+#endif
@@ -13,189 +13,712 @@
 #include <glib-unix.h>
 
 // Command line options
+static char *opt_transport = NULL;
+static gint opt_loopback_delay = 0;
+static gint opt_loopback_ind_interval = 0;
+static gint opt_loopback_lifetime = 0;
 static char *opt_device = NULL;
 static char *opt_interface = NULL;
-static gint opt_sim = 0;
+static gint opt_sim = -1;
+static gint opt_slots = 0;
+static char *opt_stats_file = NULL;
+static char *opt_capture_file = NULL;
+static char *opt_state_file = NULL;
 static gboolean opt_verbose = FALSE;
 
 static GOptionEntry option_entries[] = {
+    {"transport", 't', 0, G_OPTION_ARG_STRING, &opt_transport,
+     "Transport to qcrilNrd: gbinder or loopback (default: " TRANSPORT_DEFAULT
+     ")",
+     "NAME"},
+    {"loopback-delay", 0, 0, G_OPTION_ARG_INT, &opt_loopback_delay,
+     "Reply delay of the emulated qcrilNrd (loopback only)", "MS"},
+    {"loopback-ind-interval", 0, 0, G_OPTION_ARG_INT,
+     &opt_loopback_ind_interval,
+     "Indication period of the emulated qcrilNrd, 0 for none (loopback only)",
+     "MS"},
+    {"loopback-lifetime", 0, 0, G_OPTION_ARG_INT, &opt_loopback_lifetime,
+     "Emulated qcrilNrd dies this long after each connection, 0 for never "
+     "(loopback only)",
+     "MS"},
     {"device", 'd', 0, G_OPTION_ARG_STRING, &opt_device,
      "Binder device path (default: " DEVICE_DEFAULT ")", "PATH"},
     {"interface", 'i', 0, G_OPTION_ARG_STRING, &opt_interface,
      "HIDL/AIDL interface name (default: " QCRILHOOK_IFACE_DEFAULT ")",
      "INTERFACE"},
-    {"sim", 's', 0, G_OPTION_ARG_INT, &opt_sim, "SIM slot index (default: 0)",
-     "INDEX"},
+    {"sim", 's', 0, G_OPTION_ARG_INT, &opt_sim,
+     "Serve only this SIM slot index (default: 0)", "INDEX"},
+    {"slots", 'n', 0, G_OPTION_ARG_INT, &opt_slots,
+     "Serve SIM slots 0..N-1 from one process", "N"},
+    {"stats-file", 0, 0, G_OPTION_ARG_FILENAME, &opt_stats_file,
+     "Write the boot timeline here on SIGUSR1 and ATEL ready", "PATH"},
+    {"capture", 0, 0, G_OPTION_ARG_FILENAME, &opt_capture_file,
+     "Capture raw responses and indications to this file", "PATH"},
+    {"state-file", 0, 0, G_OPTION_ARG_FILENAME, &opt_state_file,
+     "Keep warm-start state here (default: $RUNTIME_DIRECTORY/state)",
+     "PATH"},
     {"verbose", 'v', 0, G_OPTION_ARG_NONE, &opt_verbose,
      "Enable verbose logging", NULL},
     {NULL}};
 
-static void app_config_init(AppConfig *config) {
+// systemd passes RuntimeDirectory= as a colon separated list
+static char *tunnel_state_file(void) {
+  const char *dirs = g_getenv("RUNTIME_DIRECTORY");
+  gchar **list;
+  char *path = NULL;
+
+  if (opt_state_file)
+    return g_strdup(opt_state_file);
+  if (!dirs || !*dirs)
+    return NULL;
+
+  list = g_strsplit(dirs, ":", 2);
+  path = g_build_filename(list[0], "state", NULL);
+  g_strfreev(list);
+  return path;
+}
+
+static void tunnel_config_init(TunnelConfig *config) {
+  config->transport =
+      g_strdup(opt_transport ? opt_transport : TRANSPORT_DEFAULT);
   config->device = g_strdup(opt_device ? opt_device : DEVICE_DEFAULT);
   config->interface =
       g_strdup(opt_interface ? opt_interface : QCRILHOOK_IFACE_DEFAULT);
-  config->sim = opt_sim;
-
-  config->name = g_strdup_printf("%s%d", QCRILHOOK_NAME_BASE, config->sim);
-  config->fqname = g_strdup_printf("%s/%s", config->interface, config->name);
 
   // Build used interfaces
   config->resp_iface = g_strdup_printf("%sResponse", config->interface);
   config->ind_iface = g_strdup_printf("%sIndication", config->interface);
+  config->stats_file = g_strdup(opt_stats_file);
+  config->capture_file = g_strdup(opt_capture_file);
+  config->state_file = tunnel_state_file();
 
   GINFO("Configuration:");
+  GINFO("  Transport: %s", config->transport);
   GINFO("  Device: %s", config->device);
   GINFO("  Interface: %s", config->interface);
-  GINFO("  Name: %s", config->name);
-  GINFO("  FQNAME: %s", config->fqname);
   GINFO("  Response Interface: %s", config->resp_iface);
   GINFO("  Indication Interface: %s", config->ind_iface);
+  if (config->stats_file)
+    GINFO("  Stats File: %s", config->stats_file);
+  if (config->capture_file)
+    GINFO("  Capture File: %s", config->capture_file);
+  if (config->state_file)
+    GINFO("  State File: %s", config->state_file);
 }
 
-static void app_config_cleanup(AppConfig *config) {
+static void tunnel_config_cleanup(TunnelConfig *config) {
+  g_free(config->transport);
   g_free(config->device);
   g_free(config->interface);
-  g_free(config->name);
-  g_free(config->fqname);
   g_free(config->resp_iface);
   g_free(config->ind_iface);
+  g_free(config->stats_file);
+  g_free(config->capture_file);
+  g_free(config->state_file);
+}
+
+static void app_config_init(AppConfig *config, const TunnelConfig *shared,
+                            int sim) {
+  config->sim = sim;
+  config->name = g_strdup_printf("%s%d", QCRILHOOK_NAME_BASE, config->sim);
+  config->fqname = g_strdup_printf("%s/%s", shared->interface, config->name);
+
+  GINFO("  Slot %d: %s", config->sim, config->fqname);
+}
+
+static void app_config_cleanup(AppConfig *config) {
+  g_free(config->name);
+  g_free(config->fqname);
 }
 
 static gboolean app_signal(gpointer user_data) {
-  App *app = user_data;
+  Tunnel *tunnel = user_data;
 
   GINFO("Caught signal, shutting down...");
-  g_main_loop_quit(app->loop);
+  notifier_stopping(tunnel->notifier);
+  g_main_loop_quit(tunnel->loop);
   return G_SOURCE_CONTINUE;
 }
 
-static void app_remote_died(GBinderRemoteObject *obj, void *user_data) {
-  App *app = user_data;
+static void app_mark(App *app, AppPhase phase) {
+  app_timeline_mark(&app->timeline, phase, g_get_monotonic_time());
+}
+
+static GString *tunnel_format_timeline(Tunnel *tunnel) {
+  GString *out = g_string_new(NULL);
 
-  GINFO("Remote has died, waiting for the next one...");
+  for (guint i = 0; i < tunnel->n_slots; i++) {
+    App *app = tunnel->slots + i;
 
-  app->hidl_connected = FALSE;
-  app->callbacks_set = FALSE;
+    app_timeline_format(&app->timeline, app->config.name, out);
+  }
+  return out;
 }
 
-static gboolean app_connect_remote(App *app) {
-  // check if connection has been established already
-  if (app->callbacks_set)
+static void tunnel_write_stats(Tunnel *tunnel) {
+  GError *error = NULL;
+  GString *out;
+
+  if (!tunnel->config.stats_file)
+    return;
+
+  out = tunnel_format_timeline(tunnel);
+  if (!g_file_set_contents(tunnel->config.stats_file, out->str, out->len,
+                           &error)) {
+    GWARN("Failed to write %s: %s", tunnel->config.stats_file,
+          error->message);
+    g_error_free(error);
+  }
+  g_string_free(out, TRUE);
+}
+
+static gboolean tunnel_dump_timeline(gpointer user_data) {
+  Tunnel *tunnel = user_data;
+  GString *out = tunnel_format_timeline(tunnel);
+  gchar **lines = g_strsplit(out->str, "\n", -1);
+
+  // <slot> <phase> <since start> <since previous> <last since start> <count>
+  GINFO("Boot timeline (ms):");
+  for (gchar **line = lines; *line && **line; line++)
+    GINFO("  %s", *line);
+
+  g_strfreev(lines);
+  g_string_free(out, TRUE);
+
+  for (guint i = 0; i < tunnel->n_slots; i++) {
+    const App *app = tunnel->slots + i;
+    const Coalescer *atel = &app->atel_ready_coalescer;
+
+    GINFO("%s: ATEL ready sent %" G_GUINT64_FORMAT " times on triggers, %"
+          G_GUINT64_FORMAT " duplicate triggers suppressed",
+          app->config.name, atel->performed, atel->suppressed);
+  }
+  GINFO("Payload dumps: %" G_GUINT64_FORMAT " done, %" G_GUINT64_FORMAT
+        " suppressed",
+        tunnel->dump.dumped, tunnel->dump.suppressed);
+
+  tunnel_write_stats(tunnel);
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean tunnel_dump_recorder(gpointer user_data) {
+  Tunnel *tunnel = user_data;
+  GString *out = g_string_new(NULL);
+  gchar **lines;
+
+  recorder_format(&tunnel->recorder, -1, g_get_monotonic_time(), out);
+  lines = g_strsplit(out->str, "\n", -1);
+
+  GINFO("Flight recorder, %" G_GUINT64_FORMAT " messages recorded:",
+        tunnel->recorder.count);
+  for (gchar **line = lines; *line && **line; line++)
+    GINFO("  %s", *line);
+
+  g_strfreev(lines);
+  g_string_free(out, TRUE);
+  return G_SOURCE_CONTINUE;
+}
+
+static App *tunnel_find_slot(Tunnel *tunnel, guint sim) {
+  for (guint i = 0; i < tunnel->n_slots; i++) {
+    if (tunnel->slots[i].config.sim == (int)sim)
+      return tunnel->slots + i;
+  }
+  return NULL;
+}
+
+// Until oFono has been asked, an unlock that was followed by ATEL ready in
+// the previous run is trusted
+static gboolean app_is_unlocked(App *app) {
+  SimMonitor *monitor = app->tunnel->sim_monitor;
+
+  if (app->warm_unlocked && !sim_monitor_is_settled(monitor, app->config.sim))
+    return TRUE;
+  return sim_monitor_is_unlocked(monitor, app->config.sim);
+}
+
+// Handshake phase of the slot
+static const char *app_status(App *app) {
+  switch (app->state) {
+  case APP_STATE_WAITING:
+    return "waiting for qcrilNrd";
+  case APP_STATE_CONNECTING:
+    return "connecting";
+  case APP_STATE_CONNECTED:
+    return "registering callbacks";
+  case APP_STATE_READY:
+    break;
+  }
+  if (!app_is_unlocked(app))
+    return "waiting for SIM unlock";
+  return app->atel_ready_done ? "ATEL ready" : "sending ATEL ready";
+}
+
+// Reports the phase of each slot to systemd. The service is ready once ATEL
+// ready has been acknowledged on any slot, units that need SMS reception
+// are ordered after that. The unit keeps boot from waiting for the SIM PIN.
+static void tunnel_notify(Tunnel *tunnel) {
+  gboolean ready = FALSE;
+  GString *status;
+
+  if (!tunnel->notifier)
     return;
 
-  app->remote = gbinder_servicemanager_get_service_sync(
-      app->sm, app->config.fqname, NULL); /* autoreleased pointer */
+  status = g_string_new(NULL);
+  for (guint i = 0; i < tunnel->n_slots; i++) {
+    App *app = tunnel->slots + i;
+
+    g_string_append_printf(status, "%s%s: %s", i ? "; " : "",
+                           app->config.name, app_status(app));
+    ready |= app->atel_ready_done;
+  }
+
+  notifier_status(tunnel->notifier, status->str);
+  if (ready)
+    notifier_ready(tunnel->notifier);
+  g_string_free(status, TRUE);
+}
+
+// Keeps the warm-start state of each slot for the next run. The unlock
+// status is only taken from oFono, until then the stored one stays.
+static void tunnel_save_state(Tunnel *tunnel) {
+  for (guint i = 0; i < tunnel->n_slots; i++) {
+    App *app = tunnel->slots + i;
+    const guint sim = app->config.sim;
+    WarmSlot *slot = warm_state_slot(tunnel->state, sim);
+
+    if (!slot)
+      continue;
+
+    warm_slot_update(
+        slot, sim_monitor_modem_path(tunnel->sim_monitor, sim),
+        sim_monitor_is_settled(tunnel->sim_monitor, sim)
+            ? sim_monitor_is_unlocked(tunnel->sim_monitor, sim)
+            : slot->unlocked,
+        app->atel_ready_done);
+  }
+}
+
+static void tunnel_update(Tunnel *tunnel) {
+  tunnel_notify(tunnel);
+  tunnel_save_state(tunnel);
+}
 
-  if (app->remote) {
-    GINFO("Connected to %s", app->config.fqname);
-    gbinder_remote_object_ref(app->remote);
-    app->client = gbinder_client_new(app->remote, app->config.interface);
-    app->death_id = gbinder_remote_object_add_death_handler(
-        app->remote, app_remote_died, app);
-    app->hidl_connected = TRUE;
+static void app_set_state(App *app, AppState state) {
+  static const char *const names[] = {"waiting", "connecting", "connected",
+                                      "ready"};
+
+  if (app->state != state) {
+    GDEBUG("%s: %s -> %s", app->config.name, names[app->state],
+           names[state]);
+    app->state = state;
+    tunnel_update(app->tunnel);
+  }
+}
+
+// Lookup of a registered instance. A registration that arrives during the
+// lookup restarts it, the lookup may have missed the new instance.
+static gboolean app_connect_remote(App *app) {
+  if (transport_link_connect(app->link)) {
+    app_set_state(app, APP_STATE_CONNECTING);
     return TRUE;
   }
 
-  app->hidl_connected = FALSE;
+  GERR("%s: failed to start connecting", app->config.name);
+  app_set_state(app, APP_STATE_WAITING);
   return FALSE;
 }
 
-static void app_registration_handler(GBinderServiceManager *sm,
-                                     const char *name, void *user_data) {
+// Drops everything tied to the current remote instance
+static void app_drop_remote(App *app) {
+  // no longer connected, failing transactions must not schedule retries
+  app->died_at = g_get_monotonic_time();
+  app->atel_ready_done = FALSE;
+  app_set_state(app, APP_STATE_WAITING);
+  app_cancel_transactions(app);
+  retry_cancel(&app->connect_retry);
+  retry_cancel(&app->set_callback_retry);
+  retry_cancel(&app->atel_ready_retry);
+  coalescer_cancel(&app->atel_ready_coalescer);
+  app->atel_ready_again = FALSE;
+  transport_link_disconnect(app->link);
+}
+
+static void app_remote_died(TransportLink *link, gpointer user_data) {
   App *app = user_data;
 
-  if (!strcmp(name, app->config.fqname)) {
-    GINFO("%s appeared", name);
+  GINFO("%s: remote has died, reconnecting...", app->config.name);
+  app_drop_remote(app);
+
+  // the next instance may be registered already, otherwise its
+  // registration brings us back
+  app_connect_remote(app);
+}
+
+// ATEL ready is due once per remote instance and SIM unlock
+static guint64 app_atel_ready_key(const App *app) {
+  return ((guint64)app->instance << 32) | app->unlock_epoch;
+}
+
+// Every reason to send ATEL ready ends up here, those arriving within one
+// main loop iteration result in one transaction
+static void app_trigger_atel_ready(App *app) {
+  coalescer_trigger(&app->atel_ready_coalescer, app_atel_ready_key(app));
+}
+
+static void app_atel_ready_done(App *app, gboolean ok) {
+  coalescer_complete(&app->atel_ready_coalescer, app->atel_ready_key, ok);
+  if (ok) {
+    retry_reset(&app->atel_ready_retry);
+    app->atel_ready_done = TRUE;
+    app_mark(app, APP_PHASE_ATEL);
+    tunnel_write_stats(app->tunnel);
+    tunnel_update(app->tunnel);
+  } else {
+    GERR("%s: failed to send ATEL ready", app->config.name);
+    if (app_connected(app))
+      retry_schedule(&app->atel_ready_retry);
+  }
+
+  // the key may have moved on while this one was in flight
+  if (app->atel_ready_again) {
+    app->atel_ready_again = FALSE;
+    app_trigger_atel_ready(app);
+  }
+}
+
+// Failed submissions are retried with backoff. The key is only taken over
+// when a request is submitted, one in flight completes for its own key.
+static gboolean app_send_atel_ready(App *app) {
+  retry_cancel(&app->atel_ready_retry);
+  app->atel_ready_key = app_atel_ready_key(app);
+  if (send_atel_ready(app, app_atel_ready_done))
+    return TRUE;
+
+  retry_schedule(&app->atel_ready_retry);
+  return FALSE;
+}
+
+static gboolean app_flush_atel_ready(gpointer user_data) {
+  App *app = user_data;
+
+  // the conditions may have changed since the trigger
+  if (!app_ready(app) || !app_is_unlocked(app))
+    return FALSE;
+
+  // a request for an earlier key is in flight, look again once it is done
+  if (app->atel_ready_serial) {
+    app->atel_ready_again = TRUE;
+    return FALSE;
+  }
+
+  if (app_send_atel_ready(app))
+    return TRUE;
+
+  GERR("%s: failed to submit ATEL ready", app->config.name);
+  return FALSE;
+}
 
-    if (app_connect_remote(app) && app_set_callback(app)) {
-      gboolean unlocked = sim_monitor_is_unlocked(app->sim_monitor);
-      if (unlocked)
-        send_atel_ready(app);
+static void app_callbacks_done(App *app, gboolean ok) {
+  tunnel_update(app->tunnel);
+  if (ok) {
+    retry_reset(&app->set_callback_retry);
+    app_mark(app, APP_PHASE_CALLBACKS);
+    if (app->died_at) {
+      GINFO("%s: reconnected in %" G_GINT64_FORMAT " ms", app->config.name,
+            (g_get_monotonic_time() - app->died_at) /
+                G_TIME_SPAN_MILLISECOND);
+      app->died_at = 0;
     }
+    if (app_is_unlocked(app))
+      app_trigger_atel_ready(app);
+  } else if (app_connected(app)) {
+    retry_schedule(&app->set_callback_retry);
   }
 }
 
-// Ofono SIM unlock callback
-static void on_sim_unlocked(gpointer user_data) {
+// A new reason to set the callbacks starts the backoff over
+static gboolean app_request_callbacks(App *app) {
+  retry_cancel(&app->set_callback_retry);
+  if (app_set_callback(app, app_callbacks_done))
+    return TRUE;
+
+  retry_schedule(&app->set_callback_retry);
+  return FALSE;
+}
+
+// Retry attempts. Whatever made the operation pointless in the meantime
+// counts as done, the backoff starts over next time.
+static gboolean app_retry_connect(gpointer user_data) {
+  App *app = user_data;
+
+  if (app->state != APP_STATE_WAITING) {
+    retry_cancel(&app->connect_retry);
+    return TRUE;
+  }
+  return app_connect_remote(app);
+}
+
+static gboolean app_retry_set_callback(gpointer user_data) {
   App *app = user_data;
-  SimMonitor *monitor = app->sim_monitor;
-  gboolean unlocked = sim_monitor_is_unlocked(monitor);
 
-  if (!unlocked)
+  if (!app_connected(app)) {
+    retry_cancel(&app->set_callback_retry);
+    return TRUE;
+  }
+  return app_set_callback(app, app_callbacks_done);
+}
+
+static gboolean app_retry_atel_ready(gpointer user_data) {
+  App *app = user_data;
+
+  if (!app_ready(app) || !app_is_unlocked(app) || app->atel_ready_serial ||
+      coalescer_is_done(&app->atel_ready_coalescer, app_atel_ready_key(app))) {
+    retry_cancel(&app->atel_ready_retry);
+    return TRUE;
+  }
+  app->atel_ready_key = app_atel_ready_key(app);
+  return send_atel_ready(app, app_atel_ready_done);
+}
+
+static void app_remote_appeared(TransportLink *link, gpointer user_data) {
+  App *app = user_data;
+
+  GINFO("%s appeared", app->config.fqname);
+  app_mark(app, APP_PHASE_APPEARED);
+
+  // a new instance replaces the one we talk to, even if its death has not
+  // been reported yet
+  if (app_connected(app)) {
+    GINFO("%s: new instance registered, reconnecting...", app->config.name);
+    app_drop_remote(app);
+  }
+  retry_cancel(&app->connect_retry);
+  app_connect_remote(app);
+}
+
+static void app_remote_connected(TransportLink *link, gboolean ok,
+                                 gpointer user_data) {
+  App *app = user_data;
+
+  if (!ok) {
+    GINFO("%s: not available, waiting for registration", app->config.name);
+    app_set_state(app, APP_STATE_WAITING);
+    retry_schedule(&app->connect_retry);
     return;
+  }
 
-  GINFO("=== SIM %u UNLOCKED ===", app->config.sim);
+  retry_reset(&app->connect_retry);
+  app->instance++;
+  app_set_state(app, APP_STATE_CONNECTED);
+  app_mark(app, APP_PHASE_CONNECTED);
+  app_request_callbacks(app);
+}
 
-  // Only send ATEL ready if we have HIDL connection and callbacks set
-  if (app->hidl_connected && (app->callbacks_set || app_set_callback(app))) {
-    if (!send_atel_ready(app)) {
-      GERR("Failed to send ATEL ready after SIM unlock");
-    }
-  } else {
+static void app_response(TransportLink *link, gint32 serial, gint32 err,
+                         const void *data, gsize size, gpointer user_data) {
+  app_handle_response(user_data, serial, err, data, size);
+}
+
+static void app_indication(TransportLink *link, const void *data, gsize size,
+                           gpointer user_data) {
+  app_handle_indication(user_data, data, size);
+}
+
+static const TransportHandlers app_transport_handlers = {
+    .appeared = app_remote_appeared,
+    .connected = app_remote_connected,
+    .died = app_remote_died,
+    .response = app_response,
+    .indication = app_indication,
+};
+
+// Ofono SIM unlock callback
+static void on_sim_unlocked(guint sim_index, gpointer user_data) {
+  Tunnel *tunnel = user_data;
+  App *app = tunnel_find_slot(tunnel, sim_index);
+
+  if (!app || !app_is_unlocked(app))
+    return;
+
+  // warm_unlocked is still set only while the initial properties are
+  // evaluated, that unlock is the one the warm start went ahead with
+  if (!app->warm_unlocked)
+    app->unlock_epoch++;
+
+  GINFO("=== SIM %u UNLOCKED ===", sim_index);
+  app_mark(app, APP_PHASE_UNLOCKED);
+  tunnel_update(tunnel);
+
+  // Only send ATEL ready if we have HIDL connection and callbacks set. If
+  // setCallback is still pending, ATEL ready follows its completion.
+  if (!app_connected(app)) {
     GINFO("Waiting for HIDL connection before sending ATEL ready");
+  } else if (app_ready(app)) {
+    app_trigger_atel_ready(app);
+  } else if (!app_request_callbacks(app)) {
+    GERR("Failed to set callbacks after SIM unlock");
+  }
+}
+
+// Initial SIM properties evaluated, from now on oFono tells the unlock status
+static void on_sim_settled(guint sim_index, gpointer user_data) {
+  Tunnel *tunnel = user_data;
+  App *app = tunnel_find_slot(tunnel, sim_index);
+
+  if (app && app->warm_unlocked) {
+    app->warm_unlocked = FALSE;
+    tunnel_update(tunnel);
   }
 }
 
 // Ofono availability callback
 static void on_ofono_availability(gboolean available, gpointer user_data) {
-  App *app = user_data;
+  Tunnel *tunnel = user_data;
+
+  if (!available) {
+    GINFO("oFono became unavailable");
+    tunnel_update(tunnel);
+    return;
+  }
+
+  GINFO("oFono became available");
+  for (guint i = 0; i < tunnel->n_slots; i++) {
+    App *app = tunnel->slots + i;
 
-  if (available) {
-    gboolean unlocked = sim_monitor_is_unlocked(app->sim_monitor);
-    GINFO("oFono became available");
-    if (unlocked && app->hidl_connected &&
-        (app->callbacks_set || app_set_callback(app))) {
-      if (!send_atel_ready(app)) {
-        GERR("Failed to send ATEL ready after Ofono start");
+    app_mark(app, APP_PHASE_OFONO);
+
+    if (app_is_unlocked(app) && app_connected(app)) {
+      if (app_ready(app)) {
+        app_trigger_atel_ready(app);
+      } else {
+        app_request_callbacks(app);
       }
     }
-  } else {
-    GINFO("oFono became unavailable");
   }
+  tunnel_update(tunnel);
 }
 
-static void app_run(App *app) {
-  guint sigtrm = g_unix_signal_add(SIGTERM, app_signal, app);
-  guint sigint = g_unix_signal_add(SIGINT, app_signal, app);
+static void app_cleanup(App *app) {
+  // failing transactions must not schedule retries
+  app->state = APP_STATE_WAITING;
+  retry_cancel(&app->connect_retry);
+  retry_cancel(&app->set_callback_retry);
+  retry_cancel(&app->atel_ready_retry);
+  coalescer_cancel(&app->atel_ready_coalescer);
+  app->atel_ready_again = FALSE;
+  oem_hook_requests_cleanup(&app->requests);
+  app_cancel_transactions(app);
+  transport_link_free(app->link);
+  app->link = NULL;
+}
+
+// Picks up where the previous run within this boot left off
+static void app_warm_start(App *app, const char **modem_path) {
+  WarmSlot *slot = warm_state_slot(app->tunnel->state, app->config.sim);
+
+  if (!slot || !slot->modem_path[0])
+    return;
+
+  // the slot record stays in place, the path is copied on start
+  *modem_path = slot->modem_path;
+  app->warm_unlocked = slot->unlocked && slot->atel_ready;
+  GINFO("%s: warm start, modem %s%s", app->config.name, slot->modem_path,
+        app->warm_unlocked ? ", unlocked with ATEL ready" : "");
+}
 
-  app->hidl_connected = FALSE;
-  app->callbacks_set = FALSE;
+static void tunnel_run(Tunnel *tunnel) {
+  guint sigtrm = g_unix_signal_add(SIGTERM, app_signal, tunnel);
+  guint sigint = g_unix_signal_add(SIGINT, app_signal, tunnel);
+  guint sigusr1 = g_unix_signal_add(SIGUSR1, tunnel_dump_timeline, tunnel);
+  guint sigusr2 = g_unix_signal_add(SIGUSR2, tunnel_dump_recorder, tunnel);
+  guint *sims = g_new(guint, tunnel->n_slots);
+  const char **paths = g_new0(const char *, tunnel->n_slots);
 
   GINFO("Initializing SIM monitor...");
-  app->sim_monitor =
-      sim_monitor_new(on_sim_unlocked, on_ofono_availability, app);
-  if (!app->sim_monitor) {
+  tunnel->sim_monitor =
+      sim_monitor_new(on_sim_unlocked, on_sim_settled, on_ofono_availability,
+                      tunnel);
+  if (!tunnel->sim_monitor) {
     GERR("Failed to create SIM monitor - exit");
-    app->ret = RET_ERR;
+    tunnel->ret = RET_ERR;
+    g_source_remove(sigtrm);
+    g_source_remove(sigint);
+    g_source_remove(sigusr1);
+    g_source_remove(sigusr2);
+    g_free(sims);
+    g_free(paths);
     return;
   }
 
-  app->wait_id = gbinder_servicemanager_add_registration_handler(
-      app->sm, app->config.fqname, app_registration_handler, app);
-  GINFO("Waiting for %s", app->config.fqname);
+  for (guint i = 0; i < tunnel->n_slots; i++) {
+    App *app = tunnel->slots + i;
+
+    app->state = APP_STATE_WAITING;
+    app_mark(app, APP_PHASE_START);
+    retry_init(&app->connect_retry, app->config.name, "connect",
+               app_retry_connect, app);
+    retry_init(&app->set_callback_retry, app->config.name, "setCallback",
+               app_retry_set_callback, app);
+    retry_init(&app->atel_ready_retry, app->config.name, "ATEL ready",
+               app_retry_atel_ready, app);
+    coalescer_init(&app->atel_ready_coalescer, app->config.name, "ATEL ready",
+                   app_flush_atel_ready, app);
+    app->link = transport_link_new(tunnel->transport, app->config.fqname,
+                                   &app_transport_handlers, app);
+    oem_hook_requests_init(&app->requests, app->link);
+    GINFO("Waiting for %s", app->config.fqname);
+    sims[i] = app->config.sim;
+    app_warm_start(app, paths + i);
+  }
 
-  sim_monitor_start(app->sim_monitor, app->config.sim);
+  sim_monitor_start(tunnel->sim_monitor, sims, paths, tunnel->n_slots);
+  g_free(sims);
+  g_free(paths);
+  tunnel->service = tunnel_service_new(tunnel);
+  tunnel->notifier = notifier_new();
+  tunnel_update(tunnel);
 
-  app->loop = g_main_loop_new(NULL, TRUE);
-  app->ret = RET_OK;
-  g_main_loop_run(app->loop);
+  tunnel->loop = g_main_loop_new(NULL, TRUE);
+  tunnel->ret = RET_OK;
+  g_main_loop_run(tunnel->loop);
 
   g_source_remove(sigtrm);
   g_source_remove(sigint);
-  g_main_loop_unref(app->loop);
+  g_source_remove(sigusr1);
+  g_source_remove(sigusr2);
+  g_main_loop_unref(tunnel->loop);
+
+  tunnel_service_free(tunnel->service);
+  tunnel->service = NULL;
+
+  for (guint i = 0; i < tunnel->n_slots; i++)
+    app_cleanup(tunnel->slots + i);
 
-  gbinder_remote_object_remove_handler(app->remote, app->death_id);
-  gbinder_remote_object_unref(app->remote);
-  gbinder_local_object_drop(app->local);
-  gbinder_local_object_drop(app->resp);
-  gbinder_local_object_drop(app->ind);
-  gbinder_client_unref(app->client);
+  notifier_free(tunnel->notifier);
+  tunnel->notifier = NULL;
+
+  if (tunnel->sim_monitor) {
+    sim_monitor_stop(tunnel->sim_monitor);
+    sim_monitor_free(tunnel->sim_monitor);
+    tunnel->sim_monitor = NULL;
+  }
+}
 
-  if (app->sim_monitor) {
-    sim_monitor_stop(app->sim_monitor);
-    sim_monitor_free(app->sim_monitor);
-    app->sim_monitor = NULL;
+static Transport *tunnel_transport_new(const TunnelConfig *config) {
+  if (!strcmp(config->transport, "loopback")) {
+    return transport_loopback_new(MAX(opt_loopback_delay, 0),
+                                  MAX(opt_loopback_ind_interval, 0),
+                                  MAX(opt_loopback_lifetime, 0));
   }
+#ifdef HAVE_GBINDER
+  if (!strcmp(config->transport, "gbinder")) {
+    return transport_gbinder_new(config->device, config->interface,
+                                 config->resp_iface, config->ind_iface);
+  }
+#endif
+  GERR("Unsupported transport: %s", config->transport);
+  return NULL;
 }
 
 static gboolean parse_options(int argc, char *argv[]) {
@@ -216,40 +739,75 @@ static gboolean parse_options(int argc, char *argv[]) {
   }
 
   g_option_context_free(context);
+
+  if (opt_sim >= 0 && opt_slots > 0) {
+    g_printerr("Options --sim and --slots are mutually exclusive\n");
+    return FALSE;
+  }
+  if (opt_slots < 0) {
+    g_printerr("Invalid number of slots: %d\n", opt_slots);
+    return FALSE;
+  }
   return TRUE;
 }
 
 int main(int argc, char *argv[]) {
-  App app;
+  Tunnel tunnel;
 
-  memset(&app, 0, sizeof(app));
-  app.ret = RET_INVARG;
+  memset(&tunnel, 0, sizeof(tunnel));
+  tunnel.ret = RET_INVARG;
 
   // Parse command line options
   if (!parse_options(argc, argv)) {
     return RET_INVARG;
   }
 
-  // Initialize configuration from parsed options
-  app_config_init(&app.config);
-
   gutil_log_timestamp = FALSE;
-  gutil_log_set_type(GLOG_TYPE_STDERR, app.config.name);
+  gutil_log_set_type(GLOG_TYPE_STDERR, "qcrilmsgtunnel");
   gutil_log_default.level =
       opt_verbose ? GLOG_LEVEL_VERBOSE : GLOG_LEVEL_DEFAULT;
 
-  app.sm = gbinder_servicemanager_new(app.config.device);
-  if (app.sm) {
-    app.local =
-        gbinder_servicemanager_new_local_object(app.sm, NULL, NULL, NULL);
-    app_run(&app);
-    gbinder_servicemanager_unref(app.sm);
-    // Cleanup configuration
-    app_config_cleanup(&app.config);
+  // Initialize configuration from parsed options
+  tunnel_config_init(&tunnel.config);
+  oem_hook_dispatch_init(&tunnel.dispatch);
+  oem_hook_register_decoders(&tunnel.dispatch);
+
+  if (opt_slots > 0) {
+    tunnel.n_slots = opt_slots;
+    tunnel.slots = g_new0(App, tunnel.n_slots);
+    for (guint i = 0; i < tunnel.n_slots; i++)
+      app_config_init(&tunnel.slots[i].config, &tunnel.config, i);
   } else {
-    GERR("Failed to create service manager for device: %s", app.config.device);
-    app.ret = RET_ERR;
+    tunnel.n_slots = 1;
+    tunnel.slots = g_new0(App, 1);
+    app_config_init(&tunnel.slots[0].config, &tunnel.config,
+                    opt_sim >= 0 ? opt_sim : 0);
   }
 
-  return app.ret;
-}
\ No newline at end of file
+  for (guint i = 0; i < tunnel.n_slots; i++)
+    tunnel.slots[i].tunnel = &tunnel;
+
+  if (tunnel.config.capture_file)
+    tunnel.capture = capture_writer_new(tunnel.config.capture_file);
+  if (tunnel.config.state_file)
+    tunnel.state = warm_state_open(tunnel.config.state_file);
+
+  tunnel.transport = tunnel_transport_new(&tunnel.config);
+  if (tunnel.transport) {
+    tunnel_run(&tunnel);
+    transport_free(tunnel.transport);
+  } else {
+    tunnel.ret = RET_ERR;
+  }
+  capture_writer_free(tunnel.capture);
+  warm_state_close(tunnel.state);
+
+  for (guint i = 0; i < tunnel.n_slots; i++)
+    app_config_cleanup(&tunnel.slots[i].config);
+
+  // Cleanup configuration
+  tunnel_config_cleanup(&tunnel.config);
+  g_free(tunnel.slots);
+
+  return tunnel.ret;
+}
@@ -0,0 +1,127 @@
+/*
+ * Service state notifications to systemd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "notifier.h"
+
+#include <gutil_log.h>
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+struct notifier {
+  int fd;
+  struct sockaddr_un addr;
+  socklen_t addr_len;
+  char *status; /* last one sent */
+  gboolean ready;
+  guint watchdog_id;
+};
+
+static void notifier_send(Notifier *self, const char *msg) {
+  if (sendto(self->fd, msg, strlen(msg), MSG_NOSIGNAL,
+             (struct sockaddr *)&self->addr, self->addr_len) < 0)
+    GWARN("Failed to notify systemd: %s", strerror(errno));
+}
+
+static gboolean notifier_watchdog(gpointer user_data) {
+  notifier_send(user_data, "WATCHDOG=1");
+  return G_SOURCE_CONTINUE;
+}
+
+// Watchdog interval in us, 0 if the watchdog is not enabled for us
+static guint64 notifier_watchdog_usec(void) {
+  const char *usec = g_getenv("WATCHDOG_USEC");
+  const char *pid = g_getenv("WATCHDOG_PID");
+
+  if (!usec)
+    return 0;
+  if (pid && g_ascii_strtoull(pid, NULL, 10) != (guint64)getpid())
+    return 0;
+  return g_ascii_strtoull(usec, NULL, 10);
+}
+
+Notifier *notifier_new(void) {
+  const char *path = g_getenv("NOTIFY_SOCKET");
+  Notifier *self;
+  guint64 watchdog;
+  gsize len;
+
+  if (!path || (path[0] != '/' && path[0] != '@'))
+    return NULL;
+
+  len = strlen(path);
+  self = g_new0(Notifier, 1);
+  if (len >= sizeof(self->addr.sun_path)) {
+    GWARN("NOTIFY_SOCKET is too long: %s", path);
+    g_free(self);
+    return NULL;
+  }
+
+  self->fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (self->fd < 0) {
+    GWARN("Failed to create notification socket: %s", strerror(errno));
+    g_free(self);
+    return NULL;
+  }
+
+  // leading @ stands for an abstract socket
+  self->addr.sun_family = AF_UNIX;
+  memcpy(self->addr.sun_path, path, len);
+  if (path[0] == '@')
+    self->addr.sun_path[0] = 0;
+  self->addr_len = offsetof(struct sockaddr_un, sun_path) + len;
+
+  watchdog = notifier_watchdog_usec();
+  if (watchdog) {
+    const guint interval = MAX(watchdog / 2000, 1);
+
+    GINFO("Watchdog enabled, pinging every %u ms", interval);
+    self->watchdog_id = g_timeout_add(interval, notifier_watchdog, self);
+  }
+  return self;
+}
+
+void notifier_free(Notifier *self) {
+  if (!self)
+    return;
+
+  if (self->watchdog_id)
+    g_source_remove(self->watchdog_id);
+  close(self->fd);
+  g_free(self->status);
+  g_free(self);
+}
+
+void notifier_ready(Notifier *self) {
+  if (!self || self->ready)
+    return;
+
+  self->ready = TRUE;
+  notifier_send(self, "READY=1");
+}
+
+void notifier_status(Notifier *self, const char *status) {
+  char *msg;
+
+  if (!self || !g_strcmp0(self->status, status))
+    return;
+
+  g_free(self->status);
+  self->status = g_strdup(status);
+  msg = g_strconcat("STATUS=", status, NULL);
+  notifier_send(self, msg);
+  g_free(msg);
+}
+
+void notifier_stopping(Notifier *self) {
+  if (self)
+    notifier_send(self, "STOPPING=1");
+}
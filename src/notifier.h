@@ -0,0 +1,46 @@
+/*
+ * Service state notifications to systemd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef NOTIFIER_H
+#define NOTIFIER_H
+
+#include <glib.h>
+
+typedef struct notifier Notifier;
+
+/**
+ * Connect to $NOTIFY_SOCKET and, if $WATCHDOG_USEC is set for this
+ * process, send WATCHDOG=1 from the main loop at half the interval
+ * @return: Notifier or NULL when not started by systemd
+ */
+Notifier *notifier_new(void);
+
+/**
+ * Stop the watchdog and free the notifier
+ * @param notifier: Notifier (can be NULL)
+ */
+void notifier_free(Notifier *notifier);
+
+/**
+ * Send READY=1, only the first call has an effect
+ * @param notifier: Notifier (can be NULL)
+ */
+void notifier_ready(Notifier *notifier);
+
+/**
+ * Send STATUS=, unless it is the same as the last one
+ * @param notifier: Notifier (can be NULL)
+ * @param status: Single line status
+ */
+void notifier_status(Notifier *notifier, const char *status);
+
+/**
+ * Send STOPPING=1
+ * @param notifier: Notifier (can be NULL)
+ */
+void notifier_stopping(Notifier *notifier);
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * QCRIL OEM hook raw frame parsing
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "oemhook.h"
+
+typedef union oem_hook_magic {
+  char chars[OEM_STRING_LEN];
+  guint64 value;
+} OemHookMagic;
+
+static const OemHookMagic oem_magic = {.chars = OEM_STRING};
+static const OemHookMagic oem_magic_alt = {.chars = OEM_STRING_ALT};
+
+// memcpy with constant size compiles into a plain (unaligned) load
+static inline gint32 load_int32(const guint8 *ptr) {
+  gint32 value;
+
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+void oem_hook_atel_ready_init(AtelReadyPayload *payload, gboolean ready) {
+  static const AtelReadyPayload atel_ready = {
+      .oem = OEM_CHARS,
+      .requestId = QCRIL_EVT_HOOK_SET_ATEL_UI_STATUS,
+      .payloadLen = 1,
+      .isReady = 1};
+
+  *payload = atel_ready;
+  payload->isReady = ready ? 1 : 0;
+}
+
+gboolean parse_oem_hook_message(const void *data, gsize data_len,
+                                OemHookFrame *frame) {
+  const guint8 *ptr = data;
+  guint64 magic;
+
+  memset(frame, 0, sizeof(*frame));
+
+  if (G_UNLIKELY(!ptr || data_len < sizeof(gint32)))
+    return FALSE;
+
+  frame->oem_hook_id = load_int32(ptr);
+
+  // header must be complete and carry one of the magics
+  if (data_len < OEM_HOOK_HEADER_SIZE)
+    return FALSE;
+
+  memcpy(&magic, ptr + sizeof(gint32), sizeof(magic));
+  if (magic != oem_magic.value && magic != oem_magic_alt.value)
+    return FALSE;
+
+  frame->resp_id = load_int32(ptr + sizeof(gint32) + OEM_STRING_LEN);
+
+  // negative size or payload beyond the end of the buffer
+  const gint32 size = load_int32(ptr + 2 * sizeof(gint32) + OEM_STRING_LEN);
+  if (size < 0 || (gsize)size > data_len - OEM_HOOK_HEADER_SIZE)
+    return FALSE;
+
+  frame->size = size;
+  frame->payload = size ? ptr + OEM_HOOK_HEADER_SIZE : NULL;
+  return TRUE;
+}
@@ -0,0 +1,66 @@
+/*
+ * QCRIL OEM hook raw frame parsing
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef OEMHOOK_H
+#define OEMHOOK_H
+
+#include <glib.h>
+
+#define OEM_CHARS {'Q', 'O', 'E', 'M', 'H', 'O', 'O', 'K'}
+#define OEM_STRING "QOEMHOOK"
+#define OEM_STRING_ALT "SOMCHOOK"
+#define OEM_STRING_LEN 8
+
+#define RIL_UNSOL_OEM_HOOK_RAW 1028
+
+#define QCRIL_EVT_HOOK_SET_ATEL_UI_STATUS 524314
+
+#define RADIO_ALIGNED(x) __attribute__((aligned(x)))
+
+/*
+ * Raw frame: oem_hook_id, magic, resp_id, payload size, payload. All
+ * integers are 32-bit in host byte order and are not necessarily aligned.
+ */
+#define OEM_HOOK_HEADER_SIZE (3 * sizeof(gint32) + OEM_STRING_LEN)
+
+/*
+ * View over a parsed frame. Nothing is copied, payload points into the
+ * buffer passed to parse_oem_hook_message() and is valid as long as it is.
+ */
+typedef struct oem_hook_frame {
+  gint32 oem_hook_id;
+  gint32 resp_id;
+  guint32 size;          /* payload size in bytes */
+  const guint8 *payload; /* NULL if size is 0 */
+} OemHookFrame;
+
+typedef struct {
+  char oem[8] RADIO_ALIGNED(8); /* "QOEMHOOK" (no NUL) */
+  gint32 requestId
+      RADIO_ALIGNED(4); /* QCRIL_EVT_HOOK_SET_ATEL_UI_STATUS (524314) */
+  gint32 payloadLen RADIO_ALIGNED(4); /* length of following payload */
+  gint8 isReady RADIO_ALIGNED(1);     /* 1 = ready, 0 = not ready */
+} RADIO_ALIGNED(4) AtelReadyPayload;
+
+/**
+ * Fill ATEL UI status request
+ * @param payload: Request to fill
+ * @param ready: ATEL readiness to report
+ */
+void oem_hook_atel_ready_init(AtelReadyPayload *payload, gboolean ready);
+
+/**
+ * Parse raw OEM hook frame. Accepts both QOEMHOOK and SOMCHOOK magics.
+ * @param data: Frame buffer, any alignment
+ * @param data_len: Buffer size in bytes
+ * @param frame: Parsed view, oem_hook_id is filled in whenever the buffer
+ * holds at least one integer
+ * @return: TRUE if the frame is valid
+ */
+gboolean parse_oem_hook_message(const void *data, gsize data_len,
+                                OemHookFrame *frame);
+
+#endif
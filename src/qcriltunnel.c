@@ -10,280 +10,226 @@
 
 #include <gutil_log.h>
 
-static gint32 global_serial = 1; // first serial value
-
-static void dump_data(const GBinderReader *reader, const char *prefix) {
-  const int level = GLOG_LEVEL_DEFAULT;
-  gsize size = 0;
-  const guint8 *data = gbinder_reader_get_data(reader, &size);
-
-  if (data && size > 0) {
-    gutil_log_dump(&gutil_log_default, level, prefix ? prefix : "  ", data,
-                   size);
-    GINFO("data dumped above: size=%zu", size);
-  } else {
-    GINFO("(no data)");
-  }
-}
-
-static gboolean parse_oem_hook_message(const void *data, gsize data_len,
-                                       gint32 *oem_hook_id, gint32 *resp_id,
-                                       gint32 *resp_size,
-                                       const void **resp_data) {
-  const void *ptr = (const void *)data;
-
-  // Initialize output parameters
-  *oem_hook_id = 0;
-  *resp_id = 0;
-  *resp_size = 0;
-  *resp_data = NULL;
-
-  // Check minimum size for oem_hook_id
-  if (data_len < sizeof(gint32)) {
-    return FALSE;
-  }
-
-  // Extract OEM Hook ID
-  *oem_hook_id = *(const gint32 *)ptr;
-  ptr += sizeof(gint32);
-
-  // Check if data is sufficient to proceed as raw oem hook message
-  const gsize oem_strlen = strlen(OEM_STRING);
-  const gsize lenmin = sizeof(gint32) + oem_strlen + 2 * sizeof(gint32);
-  if (data_len < lenmin)
-    return FALSE;
+// Hex dump of the payload, gated by log level and rate limited per resp_id.
+// Responses are limited on their own, resp_id is not used for them.
+static void dump_payload(Tunnel *tunnel, gboolean response, gint32 resp_id,
+                         const char *prefix, const void *data, gsize size) {
+  if (!data || !size)
+    return;
 
-  // Check if it's the expected OEM Hook ID
-  // Note that in this case, last `\0` is not a part of comparison
-  if (strncmp(ptr, OEM_STRING, oem_strlen) != 0 &&
-      strncmp(ptr, OEM_STRING, oem_strlen) != 0) {
-    return FALSE;
+  if (GLOG_ENABLED(GLOG_LEVEL_VERBOSE)) {
+    gutil_log_dump(&gutil_log_default, GLOG_LEVEL_VERBOSE, prefix, data,
+                   MIN(size, DUMP_MAX_BYTES));
+    tunnel->dump.dumped++;
+    return;
   }
 
-  ptr += oem_strlen;
-
-  *resp_id = *(const gint32 *)ptr;
-  ptr += sizeof(gint32);
-
-  *resp_size = *(const gint32 *)ptr;
-  ptr += sizeof(gint32);
+  const gint64 now = g_get_monotonic_time();
+  guint suppressed = 0;
+  if (!GLOG_ENABLED(GLOG_LEVEL_DEFAULT) ||
+      !(response
+            ? dump_limiter_take_response(&tunnel->dump, now, &suppressed)
+            : dump_limiter_take(&tunnel->dump, resp_id, now, &suppressed)))
+    return;
 
-  // validate size for payload
-  if (*resp_size > 0 && data_len < lenmin + *resp_size) {
-    GERR("parse_oem_hook_message: data size is smaller (%zu) than expected "
-         "(%zu)",
-         data_len, lenmin + *resp_size);
-    return FALSE;
-  }
+  if (suppressed && response)
+    GINFO("%u response payload dumps suppressed since the last one",
+          suppressed);
+  else if (suppressed)
+    GINFO("%u payload dumps suppressed since the last one, resp_id=%d",
+          suppressed, resp_id);
+  gutil_log_dump(&gutil_log_default, GLOG_LEVEL_DEFAULT, prefix, data,
+                 MIN(size, DUMP_MAX_BYTES));
+}
 
-  *resp_data = ptr;
+// Flight recorder and, if enabled, capture file
+static void app_record(App *app, RecordKind kind, gint32 serial,
+                       gint32 resp_id, gint32 err, const void *data,
+                       gsize size) {
+  const gint64 now = g_get_monotonic_time();
+  Tunnel *tunnel = app->tunnel;
+
+  recorder_add(&tunnel->recorder, kind, app->config.sim, serial, resp_id, err,
+               data, size, now);
+  if (tunnel->capture && kind != RECORD_REQUEST)
+    capture_writer_add(tunnel->capture,
+                       kind == RECORD_RESPONSE ? CAPTURE_RESPONSE
+                                               : CAPTURE_INDICATION,
+                       app->config.sim, serial, err, data, size, now);
+}
 
-  return TRUE;
+// QCOM_HOOK_RESPONSE_RAW
+void app_handle_response(App *app, gint32 serial, gint32 err,
+                         const void *data, gsize size) {
+  app_record(app, RECORD_RESPONSE, serial, 0, err, data, size);
+  GINFO("%s: response QCOM_HOOK_RESPONSE_RAW: serial=%d; err=%d; "
+        "data_len=%zu",
+        app->config.name, serial, err, size);
+  dump_payload(app->tunnel, TRUE, 0, "payload: ", data, size);
+
+  if (!oem_hook_requests_complete(&app->requests, serial, err, data, size))
+    GDEBUG("%s: no request waiting for serial %d", app->config.name, serial);
 }
 
-static GBinderLocalReply *resp_tx_handler(GBinderLocalObject *obj,
-                                          GBinderRemoteRequest *req, guint code,
-                                          guint flags, int *status,
-                                          void *user_data) {
-  App *app = user_data;
-  GBinderReader reader;
-  gbinder_remote_request_init_reader(req, &reader);
-
-  // GINFO("Response transaction %u received", code);
-  // dump_data(&reader, "    ");
-
-  if (code == QCOM_HOOK_RESPONSE_RAW) {
-    gint32 serial = 0;
-    gint32 err = 0;
-    gsize len, elemsize;
-    const void *data;
-    if (gbinder_reader_read_int32(&reader, &serial) &&
-        gbinder_reader_read_int32(&reader, &err)) {
-      data = gbinder_reader_read_hidl_vec(&reader, &len, &elemsize);
-      const gsize buflen = len * elemsize;
-      GINFO("Response QCOM_HOOK_RESPONSE_RAW: serial=%d; err=%d; "
-            "data_len=%lu",
-            serial, err, buflen);
-      if (buflen > 0 && data)
-        gutil_log_dump(&gutil_log_default, GLOG_LEVEL_DEFAULT,
-                       "payload: ", data, buflen < 256 ? buflen : 256);
-
-    } else {
-      GERR("Error while reading response transaction %u", code);
+// QCOM_HOOK_INDICATION_RAW
+void app_handle_indication(App *app, const void *data, gsize size) {
+  OemHookFrame frame;
+  const gboolean parsed = parse_oem_hook_message(data, size, &frame);
+
+  app_record(app, RECORD_INDICATION, 0, parsed ? frame.resp_id : 0, 0, data,
+             size);
+  if (parsed) {
+    if (frame.oem_hook_id == RIL_UNSOL_OEM_HOOK_RAW)
+      GINFO("%s: received RIL_UNSOL_OEM_HOOK_RAW with resp_id=%d %s; "
+            "resp_size=%u",
+            app->config.name, frame.resp_id, oem_hook_ind_name(frame.resp_id),
+            frame.size);
+    else
+      GINFO("Received unknown QCOM_HOOK_INDICATION_RAW indication");
+    dump_payload(app->tunnel, FALSE, frame.resp_id, "payload: ",
+                 frame.payload, frame.size);
+    if (frame.oem_hook_id == RIL_UNSOL_OEM_HOOK_RAW) {
+      oem_hook_dispatch(&app->tunnel->dispatch, frame.resp_id, frame.payload,
+                        frame.size, app);
+      if (app->tunnel->service)
+        tunnel_service_indication(app->tunnel->service, app, frame.resp_id,
+                                  frame.payload, frame.size);
     }
-
   } else {
-    GINFO("Unhandled response transaction %u", code);
+    GINFO("Failed to parse QCOM_HOOK_INDICATION_RAW indication using RAW "
+          "format. oem_id=%d. Ignoring "
+          "message",
+          frame.oem_hook_id);
   }
-
-  *status = GBINDER_STATUS_OK;
-  return NULL;
 }
 
-static const char *get_oem_response_action(gint32 response_id) {
-  switch (response_id) {
-  case 525299:
-    return "IncrNwScanInd";
-  case 525300:
-    return "EngineerMode";
-  case 525302:
-    return "DeviceConfig";
-  case 525303:
-    return "AudioStateChanged";
-  case 525305:
-    return "ClearConfigs";
-  case 525311:
-    return "ValidateConfigs";
-  case 525312:
-    return "ValidateDumped";
-  case 525320:
-    return "PdcConfigsList";
-  case 525322:
-    return "AdnInitDone";
-  case 525323:
-    return "AdnRecordsInd";
-  case 525340:
-    return "CsgChangedInd";
-  case 525341:
-    return "RacChange";
-  default:
-    return "";
-  }
+typedef struct app_transact {
+  App *app;
+  AppTransactFunc done;
+} AppTransact;
+
+static AppTransact *app_transact_new(App *app, AppTransactFunc done) {
+  AppTransact *tx = g_new0(AppTransact, 1);
+
+  tx->app = app;
+  tx->done = done;
+  return tx;
 }
 
-static GBinderLocalReply *ind_tx_handler(GBinderLocalObject *obj,
-                                         GBinderRemoteRequest *req, guint code,
-                                         guint flags, int *status,
-                                         void *user_data) {
-  App *app = user_data;
-  GBinderReader reader;
-  gbinder_remote_request_init_reader(req, &reader);
-
-  // dump_data(&reader, "ind    ");
-
-  if (code == QCOM_HOOK_INDICATION_RAW) {
-    gsize len, elemsize;
-    const void *data = gbinder_reader_read_hidl_vec(&reader, &len, &elemsize);
-    const size_t buflen = len * elemsize;
-
-    gint32 oem_hook_id;
-    gint32 resp_id;
-    gint32 resp_size;
-    const void *resp_data;
-
-    if (parse_oem_hook_message(data, buflen, &oem_hook_id, &resp_id, &resp_size,
-                               &resp_data)) {
-      if (oem_hook_id == 1028)
-        GINFO("Received RIL_UNSOL_OEM_HOOK_RAW with resp_id=%d %s; "
-              "resp_size=%d",
-              resp_id, get_oem_response_action(resp_id), resp_size);
-      else
-        GINFO("Received unknown QCOM_HOOK_INDICATION_RAW indication");
-      if (resp_size > 0 && resp_data)
-        gutil_log_dump(&gutil_log_default, GLOG_LEVEL_DEFAULT,
-                       "payload: ", resp_data,
-                       resp_size < 256 ? resp_size : 256);
-    } else {
-      GINFO("Failed to parse QCOM_HOOK_INDICATION_RAW indication using RAW "
-            "format. oem_id=%d. Ignoring "
-            "message",
-            oem_hook_id);
-    }
+static void app_transact_free(gpointer data) { g_free(data); }
+
+// Whether qcrilNrd answers ATEL ready with QCOM_HOOK_RESPONSE_RAW has not
+// been confirmed on hardware, a completed transaction is enough as it was
+// before requests were matched with their responses
+static void atel_ready_response(int status, gint32 err, const void *data,
+                                gsize size, gpointer user_data) {
+  AppTransact *tx = user_data;
+  App *app = tx->app;
+  gboolean ok = FALSE;
+
+  app->atel_ready_serial = 0;
+
+  if (status == OEM_HOOK_STATUS_NO_RESPONSE) {
+    GINFO("%s: ATEL ready sent successfully, no response", app->config.name);
+    ok = TRUE;
+  } else if (status != TRANSPORT_STATUS_OK) {
+    GERR("%s: ATEL ready failed, status=%d", app->config.name, status);
+  } else if (err) {
+    GERR("%s: ATEL ready rejected, err=%d", app->config.name, err);
   } else {
-    GINFO("Unhandled indication transaction %u", code);
+    GINFO("%s: ATEL ready sent successfully", app->config.name);
+    ok = TRUE;
   }
 
-  *status = GBINDER_STATUS_OK;
-  return NULL;
+  if (tx->done)
+    tx->done(app, ok);
 }
 
 // send ATEL ready over IQtiOemHook
-int send_atel_ready(App *app) {
-  AtelReadyPayload payload = {.oem = OEM_CHARS,
-                              .requestId = QCRIL_EVT_HOOK_SET_ATEL_UI_STATUS,
-                              .payloadLen = 1,
-                              .isReady = 1};
-
+int send_atel_ready(App *app, AppTransactFunc done) {
+  AtelReadyPayload payload;
   const gsize buflen = sizeof(payload);
 
-  GBinderLocalRequest *req = gbinder_client_new_request(app->client);
-  GBinderWriter writer;
-  if (!req)
-    return 0;
-
-  gbinder_local_request_init_writer(req, &writer);
-  gbinder_writer_append_int32(&writer, global_serial++);
-  gbinder_writer_append_hidl_vec(&writer, &payload, buflen, sizeof(gint8));
+  if (app->atel_ready_serial) {
+    GDEBUG("ATEL ready already in flight");
+    return 1;
+  }
 
-  int status = 0;
+  oem_hook_atel_ready_init(&payload, TRUE);
 
-  GINFO("Sending ATEL ready, buflen=%zu, transaction=%u", buflen,
-        TRANSACTION_OEMHOOK_RAW_REQUEST);
+  GINFO("%s: sending ATEL ready, buflen=%zu", app->config.name, buflen);
 
-  GBinderRemoteReply *reply = gbinder_client_transact_sync_reply(
-      app->client, TRANSACTION_OEMHOOK_RAW_REQUEST, req, &status);
+  AppTransact *tx = app_transact_new(app, done);
+  app->atel_ready_serial = app_submit_request(
+      app, &payload, buflen, atel_ready_response, tx, app_transact_free);
 
-  if (status != GBINDER_STATUS_OK) {
-    GERR("oemHookRawRequest transact failed, status=%d", status);
-    gbinder_local_request_unref(req);
-    if (reply)
-      gbinder_remote_reply_unref(reply);
+  if (!app->atel_ready_serial) {
+    GERR("oemHookRawRequest submission failed");
+    app_transact_free(tx);
     return 0;
   }
 
-  if (reply) {
-    GBinderReader reader;
-    gbinder_remote_reply_init_reader(reply, &reader);
-
-    gsize len = 0, elemsz = 0;
-    const void *rdata = gbinder_reader_read_hidl_vec(&reader, &len, &elemsz);
-    if (rdata && len > 0) {
-      gutil_log_dump(&gutil_log_default, GLOG_LEVEL_DEFAULT,
-                     "oemHookRawRequest reply payload: ", rdata,
-                     (len * elemsz) < 256 ? (len * elemsz) : 256);
-    } else {
-      GINFO("oemHookRawRequest: zero length reply");
-    }
-
-    gbinder_remote_reply_unref(reply);
-  }
+  return 1;
+}
 
-  gbinder_local_request_unref(req);
+gint32 app_submit_request(App *app, const void *data, gsize size,
+                          OemHookResponseFunc func, gpointer user_data,
+                          GDestroyNotify destroy) {
+  const gint32 serial = oem_hook_requests_submit(
+      &app->requests, data, size, 0, func, user_data, destroy);
 
-  GINFO("ATEL ready sent successfully");
-  return 1;
+  if (serial)
+    app_record(app, RECORD_REQUEST, serial, 0, 0, data, size);
+  return serial;
 }
 
-gboolean app_set_callback(App *app) {
-  // check if callback has been set already
-  if (app->callbacks_set)
-    return;
+static void set_callback_reply(TransportLink *link, int status,
+                               const void *data, gsize size,
+                               gpointer user_data) {
+  AppTransact *tx = user_data;
+  App *app = tx->app;
 
-  GBinderLocalRequest *req = gbinder_client_new_request(app->client);
+  app->set_callback_tx = 0;
 
-  app->resp = gbinder_servicemanager_new_local_object(
-      app->sm, app->config.resp_iface, resp_tx_handler, app);
-  app->ind = gbinder_servicemanager_new_local_object(
-      app->sm, app->config.ind_iface, ind_tx_handler, app);
+  if (status == TRANSPORT_STATUS_OK) {
+    GINFO("%s: setCallback succeeded", app->config.name);
+    app->state = APP_STATE_READY;
+  } else {
+    GERR("%s: setCallback failed, status %d", app->config.name, status);
+  }
 
-  // write the two strong binder objects into the request:
-  gbinder_local_request_append_local_object(req, app->resp);
-  gbinder_local_request_append_local_object(req, app->ind);
+  if (tx->done)
+    tx->done(app, app_ready(app));
+}
 
-  int status = 0;
-  GBinderRemoteReply *reply = gbinder_client_transact_sync_reply(
-      app->client, TRANSACTION_setCallback, req, &status);
+gboolean app_set_callback(App *app, AppTransactFunc done) {
+  // check if callback has been set already or is being set
+  if (app_ready(app) || app->set_callback_tx)
+    return TRUE;
 
-  if (status == GBINDER_STATUS_OK) {
-    GINFO("%s: setCallback succeeded", app->config.interface);
-    app->callbacks_set = TRUE;
-  } else {
-    GERR("%s: setCallback failed, status %d", app->config.interface, status);
-    app->callbacks_set = FALSE;
+  if (!app_connected(app)) {
+    GERR("%s: setCallback without connection", app->config.name);
+    return FALSE;
+  }
+
+  AppTransact *tx = app_transact_new(app, done);
+  app->set_callback_tx = transport_link_set_callback(
+      app->link, set_callback_reply, tx, app_transact_free);
+
+  if (!app->set_callback_tx) {
+    GERR("%s: setCallback submission failed", app->config.name);
+    app_transact_free(tx);
     return FALSE;
   }
 
-  gbinder_remote_reply_unref(reply);
-  gbinder_local_request_unref(req);
   return TRUE;
 }
+
+// drop setCallback and fail raw requests, e.g. when the remote is gone
+void app_cancel_transactions(App *app) {
+  if (app->set_callback_tx) {
+    transport_link_cancel(app->link, app->set_callback_tx);
+    app->set_callback_tx = 0;
+  }
+  oem_hook_requests_abort(&app->requests, TRANSPORT_STATUS_DEAD);
+}
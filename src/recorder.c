@@ -0,0 +1,55 @@
+/*
+ * Flight recorder of the traffic with qcrilNrd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "recorder.h"
+
+#include <string.h>
+
+static const char *const record_kind_names[RECORD_KIND_COUNT] = {
+    [RECORD_REQUEST] = "request",
+    [RECORD_RESPONSE] = "response",
+    [RECORD_INDICATION] = "indication",
+};
+
+void recorder_add(Recorder *recorder, RecordKind kind, guint slot,
+                  gint32 serial, gint32 resp_id, gint32 err,
+                  const void *data, gsize size, gint64 now) {
+  Record *rec = recorder->ring + (recorder->count++ % RECORDER_ENTRIES);
+
+  rec->time = now;
+  rec->kind = kind;
+  rec->slot = slot;
+  rec->size = size;
+  rec->serial = serial;
+  rec->resp_id = resp_id;
+  rec->err = err;
+  rec->stored = data ? MIN(size, RECORDER_PAYLOAD) : 0;
+  if (rec->stored)
+    memcpy(rec->payload, data, rec->stored);
+}
+
+void recorder_format(const Recorder *recorder, int slot, gint64 now,
+                     GString *out) {
+  const guint64 n = MIN(recorder->count, RECORDER_ENTRIES);
+
+  for (guint64 i = recorder->count - n; i < recorder->count; i++) {
+    const Record *rec = recorder->ring + (i % RECORDER_ENTRIES);
+
+    if (slot >= 0 && rec->slot != slot)
+      continue;
+
+    g_string_append_printf(
+        out, "-%.3f %s slot=%u serial=%d resp_id=%d err=%d size=%u ",
+        (double)(now - rec->time) / G_TIME_SPAN_MILLISECOND,
+        record_kind_names[rec->kind], rec->slot, rec->serial, rec->resp_id,
+        rec->err, rec->size);
+    for (guint k = 0; k < rec->stored; k++)
+      g_string_append_printf(out, "%02x", rec->payload[k]);
+    if (rec->stored < rec->size)
+      g_string_append(out, "...");
+    g_string_append_c(out, '\n');
+  }
+}
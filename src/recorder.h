@@ -0,0 +1,69 @@
+/*
+ * Flight recorder of the traffic with qcrilNrd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <glib.h>
+
+// The last RECORDER_ENTRIES messages with up to RECORDER_PAYLOAD bytes of
+// payload each. Recording only copies into the preallocated ring.
+#define RECORDER_ENTRIES 256
+#define RECORDER_PAYLOAD 64
+
+typedef enum record_kind {
+  RECORD_REQUEST,    /* QCOM_HOOK_RAW_REQUEST sent */
+  RECORD_RESPONSE,   /* QCOM_HOOK_RESPONSE_RAW received */
+  RECORD_INDICATION, /* QCOM_HOOK_INDICATION_RAW received */
+  RECORD_KIND_COUNT
+} RecordKind;
+
+typedef struct record {
+  gint64 time; /* monotonic */
+  guint8 kind;
+  guint8 slot;
+  guint16 stored; /* payload bytes kept */
+  guint32 size;   /* original payload size */
+  gint32 serial;  /* requests and responses */
+  gint32 resp_id; /* indications, 0 if unknown */
+  gint32 err;     /* responses */
+  guint8 payload[RECORDER_PAYLOAD];
+} Record;
+
+typedef struct recorder {
+  Record ring[RECORDER_ENTRIES];
+  guint64 count; /* records ever added */
+} Recorder;
+
+/**
+ * Record one message, overwriting the oldest one when full
+ * @param recorder: Recorder
+ * @param kind: Message kind
+ * @param slot: SIM slot of the link
+ * @param serial: Request serial or 0
+ * @param resp_id: Indication ID or 0
+ * @param err: Response error or 0
+ * @param data: Payload (can be NULL)
+ * @param size: Payload size in bytes
+ * @param now: Current monotonic time
+ */
+void recorder_add(Recorder *recorder, RecordKind kind, guint slot,
+                  gint32 serial, gint32 resp_id, gint32 err,
+                  const void *data, gsize size, gint64 now);
+
+/**
+ * Append the records from the oldest to the newest, one line each:
+ *   <ms before now> <kind> slot=<n> serial=<n> resp_id=<n> err=<n>
+ *   size=<n> <hex payload>
+ * @param recorder: Recorder
+ * @param slot: Only records of this slot, -1 for all
+ * @param now: Current monotonic time
+ * @param out: String to append to
+ */
+void recorder_format(const Recorder *recorder, int slot, gint64 now,
+                     GString *out);
+
+#endif
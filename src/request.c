@@ -0,0 +1,231 @@
+/*
+ * Raw OEM hook requests correlated with their responses by serial
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "request.h"
+
+#include <gutil_log.h>
+
+typedef struct oem_hook_request {
+  OemHookRequests *requests;
+  gint32 serial;
+  gulong tx; /* until the transport has delivered the request */
+  gint64 submitted;
+  gint64 deadline;
+  OemHookResponseFunc func;
+  gpointer user_data;
+  GDestroyNotify destroy;
+} OemHookRequest;
+
+static void oem_hook_request_free(gpointer data) {
+  OemHookRequest *req = data;
+
+  if (req->tx)
+    transport_link_cancel(req->requests->link, req->tx);
+  if (req->destroy)
+    req->destroy(req->user_data);
+  g_free(req);
+}
+
+// Removes the request from the table before calling out, so the completion
+// function is free to submit more
+static void oem_hook_request_finish(OemHookRequest *req, int status,
+                                    gint32 err, const void *data, gsize size) {
+  OemHookRequests *requests = req->requests;
+
+  g_hash_table_steal(requests->pending, GINT_TO_POINTER(req->serial));
+  if (status == TRANSPORT_STATUS_OK)
+    requests->completed++;
+  else if (status == TRANSPORT_STATUS_TIMEOUT ||
+           status == OEM_HOOK_STATUS_NO_RESPONSE)
+    requests->timed_out++;
+  else
+    requests->failed++;
+
+  GDEBUG("Request %d done in %" G_GINT64_FORMAT " us, status %d",
+         req->serial, g_get_monotonic_time() - req->submitted, status);
+  if (req->func)
+    req->func(status, err, data, size, req->user_data);
+  oem_hook_request_free(req);
+}
+
+static void oem_hook_requests_schedule(OemHookRequests *requests);
+
+static gboolean oem_hook_requests_expire(gpointer user_data) {
+  OemHookRequests *requests = user_data;
+  const gint64 now = g_get_monotonic_time();
+  GSList *expired = NULL;
+  GHashTableIter it;
+  gpointer value;
+
+  requests->timer_id = 0;
+
+  g_hash_table_iter_init(&it, requests->pending);
+  while (g_hash_table_iter_next(&it, NULL, &value)) {
+    OemHookRequest *req = value;
+
+    if (req->deadline <= now)
+      expired = g_slist_prepend(expired, GINT_TO_POINTER(req->serial));
+  }
+
+  // completions may cancel other requests, look each one up again
+  for (GSList *l = expired; l; l = l->next) {
+    OemHookRequest *req = g_hash_table_lookup(requests->pending, l->data);
+
+    if (req && req->tx) {
+      GWARN("Request %d timed out", req->serial);
+      oem_hook_request_finish(req, TRANSPORT_STATUS_TIMEOUT, 0, NULL, 0);
+    } else if (req) {
+      GWARN("Request %d got no response", req->serial);
+      oem_hook_request_finish(req, OEM_HOOK_STATUS_NO_RESPONSE, 0, NULL, 0);
+    }
+  }
+  g_slist_free(expired);
+
+  oem_hook_requests_schedule(requests);
+  return G_SOURCE_REMOVE;
+}
+
+// One timer for the earliest deadline. Completed requests leave it in place,
+// it just finds nothing to expire.
+static void oem_hook_requests_schedule(OemHookRequests *requests) {
+  gint64 deadline = G_MAXINT64;
+  GHashTableIter it;
+  gpointer value;
+
+  g_hash_table_iter_init(&it, requests->pending);
+  while (g_hash_table_iter_next(&it, NULL, &value))
+    deadline = MIN(deadline, ((OemHookRequest *)value)->deadline);
+
+  if (requests->timer_id) {
+    if (requests->timer_deadline <= deadline)
+      return;
+    g_source_remove(requests->timer_id);
+    requests->timer_id = 0;
+  }
+
+  if (deadline != G_MAXINT64) {
+    const gint64 wait = MAX(deadline - g_get_monotonic_time(), 0);
+
+    requests->timer_deadline = deadline;
+    requests->timer_id =
+        g_timeout_add((guint)((wait + G_TIME_SPAN_MILLISECOND - 1) /
+                              G_TIME_SPAN_MILLISECOND),
+                      oem_hook_requests_expire, requests);
+  }
+}
+
+// The request has been handed over (or not) to the remote, the response
+// follows as QCOM_HOOK_RESPONSE_RAW
+static void oem_hook_request_sent(TransportLink *link, int status,
+                                  const void *data, gsize size,
+                                  gpointer user_data) {
+  OemHookRequest *req = user_data;
+
+  req->tx = 0;
+  if (status != TRANSPORT_STATUS_OK) {
+    GERR("Request %d transact failed, status=%d", req->serial, status);
+    oem_hook_request_finish(req, status, 0, NULL, 0);
+  }
+}
+
+static gint32 oem_hook_requests_next_serial(OemHookRequests *requests) {
+  gint32 serial;
+
+  // positive, not in use
+  do {
+    serial = requests->next_serial;
+    requests->next_serial =
+        (requests->next_serial == G_MAXINT32) ? 1 : requests->next_serial + 1;
+  } while (g_hash_table_contains(requests->pending, GINT_TO_POINTER(serial)));
+  return serial;
+}
+
+void oem_hook_requests_init(OemHookRequests *requests, TransportLink *link) {
+  memset(requests, 0, sizeof(*requests));
+  requests->link = link;
+  requests->next_serial = 1;
+  requests->pending = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                            NULL, oem_hook_request_free);
+}
+
+void oem_hook_requests_cleanup(OemHookRequests *requests) {
+  if (requests->timer_id) {
+    g_source_remove(requests->timer_id);
+    requests->timer_id = 0;
+  }
+  if (requests->pending) {
+    g_hash_table_destroy(requests->pending);
+    requests->pending = NULL;
+  }
+}
+
+gint32 oem_hook_requests_submit(OemHookRequests *requests, const void *data,
+                                gsize size, guint timeout_ms,
+                                OemHookResponseFunc func, gpointer user_data,
+                                GDestroyNotify destroy) {
+  OemHookRequest *req = g_new0(OemHookRequest, 1);
+
+  req->requests = requests;
+  req->serial = oem_hook_requests_next_serial(requests);
+  req->submitted = g_get_monotonic_time();
+  req->deadline =
+      req->submitted + (gint64)(timeout_ms ? timeout_ms
+                                           : OEM_HOOK_REQUEST_TIMEOUT_MS) *
+                           G_TIME_SPAN_MILLISECOND;
+  req->tx = transport_link_raw_request(requests->link, req->serial, data, size,
+                                       oem_hook_request_sent, req, NULL);
+  if (!req->tx) {
+    g_free(req);
+    return 0;
+  }
+
+  // set after the submission so that failure does not call destroy
+  req->func = func;
+  req->user_data = user_data;
+  req->destroy = destroy;
+  g_hash_table_insert(requests->pending, GINT_TO_POINTER(req->serial), req);
+  oem_hook_requests_schedule(requests);
+  return req->serial;
+}
+
+gboolean oem_hook_requests_complete(OemHookRequests *requests, gint32 serial,
+                                    gint32 err, const void *data, gsize size) {
+  OemHookRequest *req =
+      g_hash_table_lookup(requests->pending, GINT_TO_POINTER(serial));
+
+  if (!req) {
+    requests->unmatched++;
+    return FALSE;
+  }
+
+  oem_hook_request_finish(req, TRANSPORT_STATUS_OK, err, data, size);
+  return TRUE;
+}
+
+void oem_hook_requests_cancel(OemHookRequests *requests, gint32 serial) {
+  g_hash_table_remove(requests->pending, GINT_TO_POINTER(serial));
+}
+
+void oem_hook_requests_abort(OemHookRequests *requests, int status) {
+  GList *serials;
+
+  if (!requests->pending)
+    return;
+
+  serials = g_hash_table_get_keys(requests->pending);
+
+  for (GList *l = serials; l; l = l->next) {
+    OemHookRequest *req = g_hash_table_lookup(requests->pending, l->data);
+
+    if (req)
+      oem_hook_request_finish(req, status, 0, NULL, 0);
+  }
+  g_list_free(serials);
+}
+
+guint oem_hook_requests_pending(const OemHookRequests *requests) {
+  return requests->pending ? g_hash_table_size(requests->pending) : 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * Raw OEM hook requests correlated with their responses by serial
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef REQUEST_H
+#define REQUEST_H
+
+#include "transport.h"
+
+#define OEM_HOOK_REQUEST_TIMEOUT_MS 5000
+
+// The transaction went through, but no QCOM_HOOK_RESPONSE_RAW followed
+// before the deadline
+#define OEM_HOOK_STATUS_NO_RESPONSE (-61)
+
+/**
+ * Completion of a raw request
+ * @param status: TRANSPORT_STATUS_OK if QCOM_HOOK_RESPONSE_RAW arrived,
+ * OEM_HOOK_STATUS_NO_RESPONSE if only the transaction completed, otherwise
+ * the transport error or TRANSPORT_STATUS_TIMEOUT
+ * @param err: Error reported by the remote in the response
+ * @param data: Response payload (can be NULL), valid only during the call
+ * @param size: Response payload size in bytes
+ * @param user_data: User data passed to oem_hook_requests_submit()
+ */
+typedef void (*OemHookResponseFunc)(int status, gint32 err, const void *data,
+                                    gsize size, gpointer user_data);
+
+/*
+ * Requests in flight on one link. Any number of them can be outstanding,
+ * each is completed by the response carrying its serial or by its deadline.
+ */
+typedef struct oem_hook_requests {
+  TransportLink *link;
+  GHashTable *pending; /* serial => OemHookRequest */
+  gint32 next_serial;
+  guint timer_id;      /* fires at timer_deadline */
+  gint64 timer_deadline;
+  guint64 completed;
+  guint64 failed;
+  guint64 timed_out;
+  guint64 unmatched; /* responses nobody waited for */
+} OemHookRequests;
+
+/**
+ * Initialize request table
+ * @param requests: Table to initialize
+ * @param link: Link to submit the requests over
+ */
+void oem_hook_requests_init(OemHookRequests *requests, TransportLink *link);
+
+/**
+ * Drop all requests in flight without completing them and free the table
+ * @param requests: Request table
+ */
+void oem_hook_requests_cleanup(OemHookRequests *requests);
+
+/**
+ * Send QCOM_HOOK_RAW_REQUEST. If 0 is returned, neither func nor destroy is
+ * called.
+ * @param requests: Request table
+ * @param data: Request payload
+ * @param size: Request payload size in bytes
+ * @param timeout_ms: Time to wait for the response, 0 for the default
+ * @param func: Completion function (can be NULL)
+ * @param user_data: User data passed to func and destroy
+ * @param destroy: Called when the request is done with
+ * @return: Serial of the request or 0 if it could not be submitted
+ */
+gint32 oem_hook_requests_submit(OemHookRequests *requests, const void *data,
+                                gsize size, guint timeout_ms,
+                                OemHookResponseFunc func, gpointer user_data,
+                                GDestroyNotify destroy);
+
+/**
+ * Complete the request matching QCOM_HOOK_RESPONSE_RAW
+ * @return: TRUE if the serial belonged to a request in flight
+ */
+gboolean oem_hook_requests_complete(OemHookRequests *requests, gint32 serial,
+                                    gint32 err, const void *data, gsize size);
+
+/**
+ * Drop one request without completing it. Destroy notification is called.
+ * @param requests: Request table
+ * @param serial: Serial returned by oem_hook_requests_submit()
+ */
+void oem_hook_requests_cancel(OemHookRequests *requests, gint32 serial);
+
+/**
+ * Complete all requests in flight with the given status, e.g. when the remote
+ * has died
+ * @param requests: Request table
+ * @param status: Status to pass to the completion functions
+ */
+void oem_hook_requests_abort(OemHookRequests *requests, int status);
+
+/**
+ * @return: Number of requests in flight
+ */
+guint oem_hook_requests_pending(const OemHookRequests *requests);
+
+#endif
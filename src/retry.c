@@ -0,0 +1,84 @@
+/*
+ * Timer driven retries with exponential backoff
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "retry.h"
+
+#include <gutil_log.h>
+
+static guint retry_delay(guint attempt) {
+  const guint base =
+      attempt < 16 ? MIN(RETRY_INITIAL_MS << attempt, RETRY_MAX_MS)
+                   : RETRY_MAX_MS;
+
+  // half fixed, half random so that slots do not retry in lockstep
+  return base / 2 + g_random_int_range(0, base / 2 + 1);
+}
+
+static gboolean retry_fire(gpointer user_data) {
+  Retry *retry = user_data;
+  const gint64 now = g_get_monotonic_time();
+
+  retry->timer_id = 0;
+  retry->attempt++;
+  GINFO("%s: %s retry %u/%u after %" G_GINT64_FORMAT " ms (%" G_GINT64_FORMAT
+        " ms since the first failure)",
+        retry->owner, retry->op, retry->attempt, RETRY_MAX_ATTEMPTS,
+        (now - retry->armed) / G_TIME_SPAN_MILLISECOND,
+        (now - retry->first_failure) / G_TIME_SPAN_MILLISECOND);
+
+  if (!retry->func(retry->user_data))
+    retry_schedule(retry);
+  return G_SOURCE_REMOVE;
+}
+
+void retry_init(Retry *retry, const char *owner, const char *op,
+                RetryFunc func, gpointer user_data) {
+  memset(retry, 0, sizeof(*retry));
+  retry->owner = owner;
+  retry->op = op;
+  retry->func = func;
+  retry->user_data = user_data;
+}
+
+gboolean retry_schedule(Retry *retry) {
+  if (retry->timer_id)
+    return TRUE;
+
+  if (retry->attempt >= RETRY_MAX_ATTEMPTS) {
+    GERR("%s: %s failed, giving up after %u retries", retry->owner,
+         retry->op, retry->attempt);
+    // the next event gets the full set of retries
+    retry_cancel(retry);
+    return FALSE;
+  }
+
+  retry->armed = g_get_monotonic_time();
+  if (!retry->first_failure)
+    retry->first_failure = retry->armed;
+  retry->delay_ms = retry_delay(retry->attempt);
+  retry->timer_id = g_timeout_add(retry->delay_ms, retry_fire, retry);
+  GDEBUG("%s: next %s retry in %u ms", retry->owner, retry->op,
+         retry->delay_ms);
+  return TRUE;
+}
+
+void retry_reset(Retry *retry) {
+  if (retry->first_failure)
+    GINFO("%s: %s succeeded after %u retries in %" G_GINT64_FORMAT " ms",
+          retry->owner, retry->op, retry->attempt,
+          (g_get_monotonic_time() - retry->first_failure) /
+              G_TIME_SPAN_MILLISECOND);
+  retry_cancel(retry);
+}
+
+void retry_cancel(Retry *retry) {
+  if (retry->timer_id) {
+    g_source_remove(retry->timer_id);
+    retry->timer_id = 0;
+  }
+  retry->attempt = 0;
+  retry->first_failure = 0;
+}
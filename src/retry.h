@@ -0,0 +1,73 @@
+/*
+ * Timer driven retries with exponential backoff
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef RETRY_H
+#define RETRY_H
+
+#include <glib.h>
+
+// The n-th retry waits between half and all of
+// MIN(RETRY_INITIAL_MS << n, RETRY_MAX_MS). After RETRY_MAX_ATTEMPTS
+// retries without success, the operation is left to the next event, which
+// starts over from RETRY_INITIAL_MS.
+#define RETRY_INITIAL_MS 200
+#define RETRY_MAX_MS 10000
+#define RETRY_MAX_ATTEMPTS 8
+
+/**
+ * Retry attempt
+ * @param user_data: User data passed to retry_init()
+ * @return: FALSE if the attempt could not even be submitted, which
+ * schedules the next one right away
+ */
+typedef gboolean (*RetryFunc)(gpointer user_data);
+
+/* Retry state of one operation, only a timer while a retry is pending */
+typedef struct retry {
+  const char *owner;
+  const char *op;
+  RetryFunc func;
+  gpointer user_data;
+  guint timer_id;
+  guint attempt;       /* retries since the last success */
+  guint delay_ms;      /* of the pending or last retry */
+  gint64 first_failure; /* monotonic, 0 if none since the last success */
+  gint64 armed;         /* when the pending retry was scheduled */
+} Retry;
+
+/**
+ * Initialize retry state
+ * @param retry: State to initialize
+ * @param owner: Instance name for logging, not copied
+ * @param op: Operation name for logging, not copied
+ * @param func: Retry attempt
+ * @param user_data: User data passed to func
+ */
+void retry_init(Retry *retry, const char *owner, const char *op,
+                RetryFunc func, gpointer user_data);
+
+/**
+ * Schedule the next attempt after a failure. Does nothing if one is already
+ * pending.
+ * @param retry: Retry state
+ * @return: FALSE if the retry cap has been reached
+ */
+gboolean retry_schedule(Retry *retry);
+
+/**
+ * Operation succeeded, drop pending retry and start backoff from scratch
+ * @param retry: Retry state
+ */
+void retry_reset(Retry *retry);
+
+/**
+ * Drop pending retry and start backoff from scratch next time, e.g. when
+ * the remote has died or a new event starts the operation over
+ * @param retry: Retry state
+ */
+void retry_cancel(Retry *retry);
+
+#endif
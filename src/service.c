@@ -0,0 +1,404 @@
+/*
+ * D-Bus service for sending raw OEM hook requests from other processes
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "service.h"
+#include "tunnel.h"
+
+#include <gutil_log.h>
+
+static const char service_xml[] =
+    "<node>"
+    "  <interface name='" TUNNEL_SERVICE_IFACE "'>"
+    "    <method name='SendRawRequest'>"
+    "      <arg name='request' type='ay' direction='in'/>"
+    "      <arg name='response' type='ay' direction='out'/>"
+    "    </method>"
+    "    <method name='GetFlightRecord'>"
+    "      <arg name='record' type='s' direction='out'/>"
+    "    </method>"
+    "    <method name='Subscribe'>"
+    "      <arg name='resp_ids' type='ai' direction='in'/>"
+    "    </method>"
+    "    <method name='Unsubscribe'>"
+    "      <arg name='resp_ids' type='ai' direction='in'/>"
+    "    </method>"
+    "    <signal name='Indication'>"
+    "      <arg name='resp_id' type='i'/>"
+    "      <arg name='payload' type='ay'/>"
+    "    </signal>"
+    "  </interface>"
+    "</node>";
+
+typedef struct tunnel_service_subscriber ServiceSubscriber;
+
+typedef struct service_slot {
+  TunnelService *service;
+  App *app;
+  char *path;
+  guint reg_id;
+  GQueue queue; /* GDBusMethodInvocation waiting for the next flush */
+  guint flush_id;
+} ServiceSlot;
+
+struct tunnel_service {
+  Tunnel *tunnel;
+  guint owner_id;
+  GDBusNodeInfo *node;
+  GDBusConnection *conn;
+  ServiceSlot *slots;
+  guint n_slots;
+  GHashTable *subscribers; /* unique name => ServiceSubscriber */
+  /* subscribers per unsolicited ID by offset from the base */
+  guint16 listeners[OEM_HOOK_DISPATCH_SIZE];
+};
+
+#define SERVICE_FILTER_WORDS (OEM_HOOK_DISPATCH_SIZE / 64)
+
+struct tunnel_service_subscriber {
+  TunnelService *service;
+  char *name;
+  guint watch_id;
+  guint64 filter[SERVICE_FILTER_WORDS]; /* bit per ID offset */
+};
+
+// Outlives the service if the request is still in flight
+typedef struct service_call {
+  GDBusMethodInvocation *call; /* NULL once answered */
+} ServiceCall;
+
+static void service_call_fail(GDBusMethodInvocation *call, const char *name,
+                              const char *message) {
+  g_dbus_method_invocation_return_dbus_error(call, name, message);
+}
+
+static void service_call_done(int status, gint32 err, const void *data,
+                              gsize size, gpointer user_data) {
+  ServiceCall *sc = user_data;
+  GDBusMethodInvocation *call = sc->call;
+
+  sc->call = NULL;
+  if (status != TRANSPORT_STATUS_OK) {
+    gchar *msg = g_strdup_printf("Request failed, status %d", status);
+
+    service_call_fail(call,
+                      (status == TRANSPORT_STATUS_TIMEOUT ||
+                       status == OEM_HOOK_STATUS_NO_RESPONSE)
+                          ? TUNNEL_SERVICE_ERROR ".Timeout"
+                          : TUNNEL_SERVICE_ERROR ".Failed",
+                      msg);
+    g_free(msg);
+  } else if (err) {
+    gchar *msg = g_strdup_printf("Remote error %d", err);
+
+    service_call_fail(call, TUNNEL_SERVICE_ERROR ".Rejected", msg);
+    g_free(msg);
+  } else {
+    g_dbus_method_invocation_return_value(
+        call, g_variant_new("(@ay)", g_variant_new_fixed_array(
+                                         G_VARIANT_TYPE_BYTE, data, size, 1)));
+  }
+}
+
+static void service_call_free(gpointer user_data) {
+  ServiceCall *sc = user_data;
+
+  if (sc->call)
+    service_call_fail(sc->call, TUNNEL_SERVICE_ERROR ".Cancelled",
+                      "Request dropped");
+  g_free(sc);
+}
+
+static void service_slot_submit(ServiceSlot *slot,
+                                GDBusMethodInvocation *call) {
+  App *app = slot->app;
+  GVariant *request = NULL;
+  gsize size = 0;
+  const void *data;
+
+  if (!app_ready(app)) {
+    service_call_fail(call, TUNNEL_SERVICE_ERROR ".NotReady",
+                      "Remote is not connected");
+    return;
+  }
+
+  // the invocation keeps the data alive until it is answered
+  g_variant_get(g_dbus_method_invocation_get_parameters(call), "(@ay)",
+                &request);
+  data = g_variant_get_fixed_array(request, &size, 1);
+
+  ServiceCall *sc = g_new0(ServiceCall, 1);
+  sc->call = call;
+  if (!app_submit_request(app, data, size, service_call_done, sc,
+                          service_call_free)) {
+    sc->call = NULL;
+    g_free(sc);
+    service_call_fail(call, TUNNEL_SERVICE_ERROR ".Failed",
+                      "Submission failed");
+  }
+  g_variant_unref(request);
+}
+
+static gboolean service_slot_flush(gpointer user_data) {
+  ServiceSlot *slot = user_data;
+  GDBusMethodInvocation *call;
+  guint n = 0;
+
+  slot->flush_id = 0;
+  while ((call = g_queue_pop_head(&slot->queue)) != NULL) {
+    service_slot_submit(slot, call);
+    n++;
+  }
+  GDEBUG("%s: flushed %u D-Bus request(s)", slot->app->config.name, n);
+  return G_SOURCE_REMOVE;
+}
+
+static void service_subscriber_free(gpointer data) {
+  ServiceSubscriber *sub = data;
+  TunnelService *service = sub->service;
+
+  for (guint i = 0; i < OEM_HOOK_DISPATCH_SIZE; i++) {
+    if (sub->filter[i / 64] & (G_GUINT64_CONSTANT(1) << (i % 64)))
+      service->listeners[i]--;
+  }
+  g_bus_unwatch_name(sub->watch_id);
+  g_free(sub->name);
+  g_free(sub);
+}
+
+static void service_subscriber_vanished(GDBusConnection *conn,
+                                        const gchar *name,
+                                        gpointer user_data) {
+  ServiceSubscriber *sub = user_data;
+
+  GDEBUG("Subscriber %s left", name);
+  g_hash_table_remove(sub->service->subscribers, name);
+}
+
+static ServiceSubscriber *service_subscriber_get(TunnelService *service,
+                                                 const char *name) {
+  ServiceSubscriber *sub = g_hash_table_lookup(service->subscribers, name);
+
+  if (!sub) {
+    sub = g_new0(ServiceSubscriber, 1);
+    sub->service = service;
+    sub->name = g_strdup(name);
+    g_hash_table_insert(service->subscribers, sub->name, sub);
+    sub->watch_id = g_bus_watch_name_on_connection(
+        service->conn, name, G_BUS_NAME_WATCHER_FLAGS_NONE, NULL,
+        service_subscriber_vanished, sub, NULL);
+  }
+  return sub;
+}
+
+// Validates all IDs before touching the filter
+static void service_subscribe(TunnelService *service,
+                              GDBusMethodInvocation *call, GVariant *params,
+                              gboolean subscribe) {
+  const char *sender = g_dbus_method_invocation_get_sender(call);
+  GVariant *ids = g_variant_get_child_value(params, 0);
+  gsize n = 0;
+  const gint32 *id = g_variant_get_fixed_array(ids, &n, sizeof(gint32));
+  ServiceSubscriber *sub;
+
+  for (gsize i = 0; i < n; i++) {
+    if ((guint32)(id[i] - QCRIL_EVT_HOOK_UNSOL_BASE) >=
+        OEM_HOOK_DISPATCH_SIZE) {
+      gchar *msg = g_strdup_printf("Not an unsolicited ID: %d", id[i]);
+
+      service_call_fail(call, TUNNEL_SERVICE_ERROR ".InvalidArgs", msg);
+      g_free(msg);
+      g_variant_unref(ids);
+      return;
+    }
+  }
+
+  sub = subscribe ? service_subscriber_get(service, sender)
+                  : g_hash_table_lookup(service->subscribers, sender);
+  if (sub) {
+    gboolean empty = TRUE;
+
+    for (gsize i = 0; i < n; i++) {
+      const guint index = id[i] - QCRIL_EVT_HOOK_UNSOL_BASE;
+      const guint64 bit = G_GUINT64_CONSTANT(1) << (index % 64);
+      const gboolean set = (sub->filter[index / 64] & bit) != 0;
+
+      if (subscribe && !set) {
+        sub->filter[index / 64] |= bit;
+        service->listeners[index]++;
+      } else if (!subscribe && set) {
+        sub->filter[index / 64] &= ~bit;
+        service->listeners[index]--;
+      }
+    }
+
+    for (guint i = 0; i < SERVICE_FILTER_WORDS; i++)
+      empty = empty && !sub->filter[i];
+    if (empty)
+      g_hash_table_remove(service->subscribers, sender);
+  }
+
+  g_variant_unref(ids);
+  g_dbus_method_invocation_return_value(call, NULL);
+}
+
+static void service_method_call(GDBusConnection *conn, const gchar *sender,
+                                const gchar *path, const gchar *iface,
+                                const gchar *method, GVariant *params,
+                                GDBusMethodInvocation *call,
+                                gpointer user_data) {
+  ServiceSlot *slot = user_data;
+  GVariant *request;
+
+  if (!g_strcmp0(method, "Subscribe") || !g_strcmp0(method, "Unsubscribe")) {
+    service_subscribe(slot->service, call, params,
+                      !g_strcmp0(method, "Subscribe"));
+    return;
+  } else if (!g_strcmp0(method, "GetFlightRecord")) {
+    GString *out = g_string_new(NULL);
+
+    recorder_format(&slot->service->tunnel->recorder, slot->app->config.sim,
+                    g_get_monotonic_time(), out);
+    g_dbus_method_invocation_return_value(call,
+                                          g_variant_new("(s)", out->str));
+    g_string_free(out, TRUE);
+    return;
+  } else if (g_strcmp0(method, "SendRawRequest")) {
+    g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
+                                          G_DBUS_ERROR_UNKNOWN_METHOD,
+                                          "Unknown method %s", method);
+    return;
+  }
+
+  request = g_variant_get_child_value(params, 0);
+  const gsize size = g_variant_get_size(request);
+  g_variant_unref(request);
+  if (!size || size > TUNNEL_SERVICE_MAX_REQUEST) {
+    service_call_fail(call, TUNNEL_SERVICE_ERROR ".InvalidArgs",
+                      "Invalid request size");
+    return;
+  }
+
+  // submitted together with whatever else arrives in this iteration
+  g_queue_push_tail(&slot->queue, call);
+  if (!slot->flush_id)
+    slot->flush_id = g_idle_add(service_slot_flush, slot);
+}
+
+static const GDBusInterfaceVTable service_vtable = {service_method_call, NULL,
+                                                    NULL};
+
+static void service_bus_acquired(GDBusConnection *conn, const gchar *name,
+                                 gpointer user_data) {
+  TunnelService *service = user_data;
+  GDBusInterfaceInfo *iface =
+      g_dbus_node_info_lookup_interface(service->node, TUNNEL_SERVICE_IFACE);
+
+  service->conn = g_object_ref(conn);
+  for (guint i = 0; i < service->n_slots; i++) {
+    ServiceSlot *slot = service->slots + i;
+    GError *error = NULL;
+
+    slot->reg_id = g_dbus_connection_register_object(
+        conn, slot->path, iface, &service_vtable, slot, NULL, &error);
+    if (!slot->reg_id) {
+      GERR("Failed to register %s: %s", slot->path, error->message);
+      g_error_free(error);
+    }
+  }
+}
+
+static void service_name_acquired(GDBusConnection *conn, const gchar *name,
+                                  gpointer user_data) {
+  GINFO("Acquired D-Bus name %s", name);
+}
+
+static void service_name_lost(GDBusConnection *conn, const gchar *name,
+                              gpointer user_data) {
+  GWARN("D-Bus name %s is not available", name);
+}
+
+TunnelService *tunnel_service_new(Tunnel *tunnel) {
+  TunnelService *service = g_new0(TunnelService, 1);
+
+  service->tunnel = tunnel;
+  service->node = g_dbus_node_info_new_for_xml(service_xml, NULL);
+  service->n_slots = tunnel->n_slots;
+  service->slots = g_new0(ServiceSlot, service->n_slots);
+  service->subscribers = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                               service_subscriber_free);
+  for (guint i = 0; i < service->n_slots; i++) {
+    ServiceSlot *slot = service->slots + i;
+
+    slot->service = service;
+    slot->app = tunnel->slots + i;
+    slot->path = g_strdup_printf("/%s", slot->app->config.name);
+    g_queue_init(&slot->queue);
+  }
+
+  service->owner_id = g_bus_own_name(
+      G_BUS_TYPE_SYSTEM, TUNNEL_SERVICE, G_BUS_NAME_OWNER_FLAGS_NONE,
+      service_bus_acquired, service_name_acquired, service_name_lost, service,
+      NULL);
+  return service;
+}
+
+void tunnel_service_indication(TunnelService *service, App *app,
+                               gint32 resp_id, const void *data, gsize size) {
+  const guint32 index = (guint32)(resp_id - QCRIL_EVT_HOOK_UNSOL_BASE);
+  const guint64 bit = G_GUINT64_CONSTANT(1) << (index % 64);
+  ServiceSlot *slot;
+  GVariant *params;
+  GHashTableIter it;
+  gpointer value;
+
+  // the common case, nobody is listening
+  if (index >= OEM_HOOK_DISPATCH_SIZE || !service->listeners[index] ||
+      !service->conn)
+    return;
+
+  slot = service->slots + (app - service->tunnel->slots);
+  params = g_variant_ref_sink(g_variant_new(
+      "(i@ay)", resp_id,
+      g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, data, size, 1)));
+
+  // unicast, processes that did not ask for the ID are not woken up
+  g_hash_table_iter_init(&it, service->subscribers);
+  while (g_hash_table_iter_next(&it, NULL, &value)) {
+    ServiceSubscriber *sub = value;
+
+    if (sub->filter[index / 64] & bit)
+      g_dbus_connection_emit_signal(service->conn, sub->name, slot->path,
+                                    TUNNEL_SERVICE_IFACE, "Indication",
+                                    params, NULL);
+  }
+  g_variant_unref(params);
+}
+
+void tunnel_service_free(TunnelService *service) {
+  if (!service)
+    return;
+
+  g_bus_unown_name(service->owner_id);
+  g_hash_table_destroy(service->subscribers);
+  for (guint i = 0; i < service->n_slots; i++) {
+    ServiceSlot *slot = service->slots + i;
+    GDBusMethodInvocation *call;
+
+    if (slot->flush_id)
+      g_source_remove(slot->flush_id);
+    while ((call = g_queue_pop_head(&slot->queue)) != NULL)
+      service_call_fail(call, TUNNEL_SERVICE_ERROR ".Cancelled",
+                        "Service is shutting down");
+    if (slot->reg_id)
+      g_dbus_connection_unregister_object(service->conn, slot->reg_id);
+    g_free(slot->path);
+  }
+  if (service->conn)
+    g_object_unref(service->conn);
+  g_dbus_node_info_unref(service->node);
+  g_free(service->slots);
+  g_free(service);
+}
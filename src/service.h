@@ -0,0 +1,60 @@
+/*
+ * D-Bus service for sending raw OEM hook requests from other processes
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef SERVICE_H
+#define SERVICE_H
+
+#include <gio/gio.h>
+
+#define TUNNEL_SERVICE "org.sailfishos.qcrilmsgtunnel"
+#define TUNNEL_SERVICE_IFACE TUNNEL_SERVICE ".OemHook"
+#define TUNNEL_SERVICE_ERROR TUNNEL_SERVICE ".Error"
+
+// Larger requests are rejected without reaching the remote
+#define TUNNEL_SERVICE_MAX_REQUEST 8192
+
+struct tunnel;
+struct app;
+typedef struct tunnel_service TunnelService;
+
+/**
+ * Own TUNNEL_SERVICE on the system bus and export one object per slot,
+ * /oemhook<sim>, implementing TUNNEL_SERVICE_IFACE:
+ *
+ *   SendRawRequest(ay request) -> (ay response)
+ *   GetFlightRecord() -> (s record)
+ *   Subscribe(ai resp_ids)
+ *   Unsubscribe(ai resp_ids)
+ *   signal Indication(i resp_id, ay payload)
+ *
+ * Requests received during one main loop iteration are submitted together
+ * over the slot's link and completed by their QCOM_HOOK_RESPONSE_RAW.
+ * Indications are sent only to the callers that have subscribed to their
+ * resp_id, from any object, and stop when the caller leaves the bus.
+ * @param tunnel: Tunnel whose slots are exported
+ * @return: Service instance
+ */
+TunnelService *tunnel_service_new(struct tunnel *tunnel);
+
+/**
+ * Forward unsolicited indication to its subscribers, if any
+ * @param service: Service instance
+ * @param app: Slot the indication came from
+ * @param resp_id: Indication ID
+ * @param data: Payload
+ * @param size: Payload size in bytes
+ */
+void tunnel_service_indication(TunnelService *service, struct app *app,
+                               gint32 resp_id, const void *data, gsize size);
+
+/**
+ * Release the name and fail requests not submitted yet. Requests in flight
+ * are failed when their slot drops them.
+ * @param service: Service instance (can be NULL)
+ */
+void tunnel_service_free(TunnelService *service);
+
+#endif
@@ -11,6 +11,21 @@
 #define OFONO_MANAGER_PATH "/"
 #define OFONO_MANAGER_IFACE "org.nemomobile.ofono.ModemManager"
 #define OFONO_SIM_MANAGER_IFACE "org.ofono.SimManager"
+#define OFONO_MODEMS_IFACE "org.ofono.Manager"
+
+#define OFONO_CALL_TIMEOUT 5000 /* ms */
+
+static void sim_monitor_discover(SimMonitor *monitor);
+static void sim_monitor_resolve(SimMonitor *monitor);
+
+// Aborts all ofono queries in flight and prepares for the new ones
+static void sim_monitor_cancel_queries(SimMonitor *monitor) {
+  if (monitor->cancellable) {
+    g_cancellable_cancel(monitor->cancellable);
+    g_object_unref(monitor->cancellable);
+  }
+  monitor->cancellable = g_cancellable_new();
+}
 
 static void on_ofono_name_appeared(GDBusConnection *connection,
                                    const gchar *name, const gchar *name_owner,
@@ -24,12 +39,9 @@ static void on_ofono_name_appeared(GDBusConnection *connection,
     monitor->ofono_availability_callback(TRUE, monitor->user_data);
   }
 
-  /* Start monitoring if we have a target SIM set */
-  if (monitor->sim_index != UINT_MAX) {
-    if (!sim_monitor_start(monitor, monitor->sim_index)) {
-      GERR("Failed to start SIM monitoring after ofono appeared");
-    }
-  }
+  /* Start monitoring if we have target SIMs set */
+  if (monitor->n_slots > 0)
+    sim_monitor_discover(monitor);
 }
 
 static void on_ofono_name_vanished(GDBusConnection *connection,
@@ -39,7 +51,7 @@ static void on_ofono_name_vanished(GDBusConnection *connection,
   GINFO("ofono service vanished");
   monitor->ofono_available = FALSE;
 
-  /* Stop monitoring */
+  /* Stop monitoring and drop replies that are still on the way */
   sim_monitor_stop(monitor);
 
   if (monitor->ofono_availability_callback) {
@@ -47,67 +59,188 @@ static void on_ofono_name_vanished(GDBusConnection *connection,
   }
 }
 
-static gboolean sim_monitor_get_modem_path(SimMonitor *monitor, guint sim_index,
-                                           gchar **modem_path) {
-  GError *error = NULL;
-  GVariant *result;
+// Updates cached property. Returns FALSE if the property is not a part of
+// the unlock predicate.
+static gboolean sim_properties_update(SimProperties *props, const gchar *key,
+                                      GVariant *value) {
+  if (g_strcmp0(key, "Present") == 0) {
+    props->present = g_variant_get_boolean(value);
+    if (!props->present) {
+      // the rest is stale once the card is gone
+      memset(props, 0, sizeof(*props));
+    }
+  } else if (g_strcmp0(key, "CardIdentifier") == 0) {
+    const gchar *iccid = g_variant_get_string(value, NULL);
+    props->card_identifier = (iccid && *iccid);
+  } else if (g_strcmp0(key, "PinRequired") == 0) {
+    const gchar *pin_required = g_variant_get_string(value, NULL);
+    props->no_pin = (g_strcmp0(pin_required, "none") == 0);
+  } else if (g_strcmp0(key, "SubscriberIdentity") == 0) {
+    const gchar *subid = g_variant_get_string(value, NULL);
+    props->subscriber_identity = (subid && *subid);
+  } else if (g_strcmp0(key, "MobileCountryCode") == 0) {
+    const gchar *mcc = g_variant_get_string(value, NULL);
+    props->mcc = (mcc && *mcc);
+  } else if (g_strcmp0(key, "MobileNetworkCode") == 0) {
+    const gchar *mnc = g_variant_get_string(value, NULL);
+    props->mnc = (mnc && *mnc);
+  } else {
+    return FALSE;
+  }
+  return TRUE;
+}
 
-  /* Get available modems from ofono */
-  result = g_dbus_connection_call_sync(
-      monitor->connection, OFONO_SERVICE, OFONO_MANAGER_PATH,
-      OFONO_MANAGER_IFACE, "GetAvailableModems", NULL, G_VARIANT_TYPE("(ao)"),
-      G_DBUS_CALL_FLAGS_NONE, 5000, /* 5 second timeout */
-      NULL, &error);
+// Re-evaluates unlock state from the cache and calls callback on unlock
+static void sim_slot_evaluate(SimSlot *slot) {
+  SimMonitor *monitor = slot->monitor;
+  const SimProperties *props = &slot->props;
+  gboolean was_unlocked = slot->is_unlocked;
 
-  if (!result) {
-    GERR("Failed to get available modems: %s", error->message);
-    g_error_free(error);
-    return FALSE;
+  // several properties have to either exist or have specific value to
+  // indicate that the card is unlocked. Otherwise false positive could
+  // happen while card is not loaded into ofono
+  slot->is_unlocked =
+      (props->present && props->card_identifier && props->no_pin &&
+       props->subscriber_identity && props->mcc && props->mnc);
+
+  if (was_unlocked != slot->is_unlocked)
+    GINFO("SIM %u current unlocked: %s", slot->sim_index,
+          slot->is_unlocked ? "YES" : "NO");
+
+  /* Call callback when SIM becomes unlocked */
+  if (!was_unlocked && slot->is_unlocked && monitor->sim_unlock_callback) {
+    GINFO("SIM %u unlocked, calling callback", slot->sim_index);
+    monitor->sim_unlock_callback(slot->sim_index, monitor->user_data);
   }
+}
 
-  GVariantIter *iter;
-  g_variant_get(result, "(ao)", &iter);
+static void sim_slot_settled(SimSlot *slot) {
+  SimMonitor *monitor = slot->monitor;
 
-  gchar *path;
-  guint index = 0;
-  gboolean found = FALSE;
+  if (monitor->sim_settled_callback)
+    monitor->sim_settled_callback(slot->sim_index, monitor->user_data);
+}
 
-  while (g_variant_iter_loop(iter, "o", &path)) {
-    if (index == sim_index) {
-      *modem_path = g_strdup(path);
-      found = TRUE;
-      break;
-    }
-    index++;
+static gboolean sim_slot_debounced(gpointer user_data) {
+  SimSlot *slot = user_data;
+
+  slot->evaluate_id = 0;
+  slot->bursts[MIN(slot->burst, SIM_MONITOR_BURST_BUCKETS) - 1]++;
+  GDEBUG("SIM %u: %u change(s), one evaluation", slot->sim_index,
+         slot->burst);
+  slot->burst = 0;
+  sim_slot_evaluate(slot);
+  return G_SOURCE_REMOVE;
+}
+
+// The window starts with the first change, so a steady stream of changes
+// can not hold the evaluation up
+static void sim_slot_evaluate_later(SimSlot *slot) {
+  slot->burst++;
+  if (!slot->evaluate_id)
+    slot->evaluate_id =
+        g_timeout_add(SIM_MONITOR_DEBOUNCE_MS, sim_slot_debounced, slot);
+}
+
+static void sim_slot_cancel_evaluation(SimSlot *slot) {
+  if (slot->evaluate_id) {
+    g_source_remove(slot->evaluate_id);
+    slot->evaluate_id = 0;
   }
+  slot->burst = 0;
+}
 
-  g_variant_iter_free(iter);
-  g_variant_unref(result);
+// Burst sizes, "1:n1 2:n2 ... 8+:n8"
+static gchar *sim_slot_format_bursts(const SimSlot *slot) {
+  GString *out = g_string_new(NULL);
 
-  if (!found) {
-    GERR("SIM index %u not found in available modems", sim_index);
-    return FALSE;
+  for (guint i = 0; i < SIM_MONITOR_BURST_BUCKETS; i++)
+    g_string_append_printf(out, "%s%u%s:%" G_GUINT64_FORMAT, i ? " " : "",
+                           i + 1, i + 1 == SIM_MONITOR_BURST_BUCKETS ? "+" : "",
+                           slot->bursts[i]);
+  return g_string_free(out, FALSE);
+}
+
+// SimManager.PropertyChanged of any modem
+static void sim_monitor_property_changed(
+    GDBusConnection *connection, const gchar *sender_name,
+    const gchar *object_path, const gchar *interface_name,
+    const gchar *signal_name, GVariant *parameters, gpointer user_data) {
+  SimMonitor *monitor = user_data;
+
+  if (g_strcmp0(interface_name, OFONO_SIM_MANAGER_IFACE) != 0 ||
+      g_strcmp0(signal_name, "PropertyChanged") != 0) {
+    return;
   }
 
-  GDEBUG("SIM %u mapped to modem path: %s", sim_index, *modem_path);
-  return TRUE;
+  /* Check if this signal is for one of our monitored modems */
+  SimSlot *slot = g_hash_table_lookup(monitor->paths, object_path);
+  if (!slot) {
+    return;
+  }
+
+  const gchar *property_name;
+  GVariant *property_value;
+  g_variant_get(parameters, "(&sv)", &property_name, &property_value);
+
+  gchar *value_str = g_variant_print(property_value, TRUE);
+  GINFO("SIM %u property changed: %s -> %s", slot->sim_index, property_name,
+        value_str);
+  g_free(value_str);
+
+  // The signal carries the new value, no need to fetch all properties.
+  // Until the initial GetProperties reply arrives only the cache is updated,
+  // the reply is newer than any signal received before it.
+  if (sim_properties_update(&slot->props, property_name, property_value) &&
+      slot->state == SIM_MONITOR_STATE_MONITORING) {
+    slot->roundtrips_avoided++;
+    GDEBUG("SIM %u: %" G_GUINT64_FORMAT " GetProperties round trips avoided",
+           slot->sim_index, slot->roundtrips_avoided);
+    sim_slot_evaluate_later(slot);
+  }
+
+  g_variant_unref(property_value);
 }
 
-static gboolean sim_monitor_get_current_properties(SimMonitor *monitor) {
+static void sim_slot_properties_ready(GObject *source, GAsyncResult *res,
+                                      gpointer user_data) {
   GError *error = NULL;
-  GVariant *result;
+  GVariant *result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source),
+                                                   res, &error);
 
-  /* Get current SIM properties */
-  result = g_dbus_connection_call_sync(
-      monitor->connection, OFONO_SERVICE, monitor->modem_path,
-      OFONO_SIM_MANAGER_IFACE, "GetProperties", NULL, G_VARIANT_TYPE("(a{sv})"),
-      G_DBUS_CALL_FLAGS_NONE, 5000, NULL, &error);
+  if (!result && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+    /* slot may be stopped or gone already */
+    g_error_free(error);
+    return;
+  }
+
+  SimSlot *slot = user_data;
+  slot->state = SIM_MONITOR_STATE_MONITORING;
+  g_object_unref(slot->cancellable);
+  slot->cancellable = NULL;
+
+  if (!result && slot->cached_path) {
+    SimMonitor *monitor = slot->monitor;
+
+    GWARN("Cached modem path %s of SIM %u is stale: %s", slot->modem_path,
+          slot->sim_index, error->message);
+    g_error_free(error);
+    for (guint i = 0; i < monitor->n_slots; i++) {
+      g_free(monitor->slots[i].cached_path);
+      monitor->slots[i].cached_path = NULL;
+    }
+    sim_monitor_discover(monitor);
+    return;
+  }
 
   if (!result) {
-    GERR("Failed to get SIM properties for %s: %s", monitor->modem_path,
+    GERR("Failed to get SIM properties for %s: %s", slot->modem_path,
          error->message);
     g_error_free(error);
-    return FALSE;
+    GWARN("Could not get current properties for SIM %u, will monitor anyway",
+          slot->sim_index);
+    sim_slot_settled(slot);
+    return;
   }
 
   GVariantIter *iter;
@@ -116,211 +249,372 @@ static gboolean sim_monitor_get_current_properties(SimMonitor *monitor) {
   const gchar *key;
   GVariant *value;
 
-  // several properties have to either exist or have specific value to
-  // indicate that the card is unlocked. Otherwise false positive could
-  // happen while card is not loaded into ofono
-  gboolean has_present = FALSE;
-  gboolean has_cardidentifier = FALSE;
-  gboolean has_nopin = FALSE;
-  gboolean has_subscriberid = FALSE;
-  gboolean has_mcc = FALSE;
-  gboolean has_mnc = FALSE;
-
-  while (g_variant_iter_loop(iter, "{sv}", &key, &value)) {
+  // seed the cache
+  memset(&slot->props, 0, sizeof(slot->props));
+  while (g_variant_iter_loop(iter, "{&sv}", &key, &value)) {
     gchar *value_str = g_variant_print(value, TRUE);
-    GINFO("Properties: %s -> %s", key, value_str);
+    GINFO("SIM %u properties: %s -> %s", slot->sim_index, key, value_str);
     g_free(value_str);
 
-    if (g_strcmp0(key, "Present") == 0) {
-      has_present = g_variant_get_boolean(value);
-    } else if (g_strcmp0(key, "CardIdentifier") == 0) {
-      has_cardidentifier = TRUE;
-    } else if (g_strcmp0(key, "PinRequired") == 0) {
-      const gchar *pin_required = g_variant_get_string(value, NULL);
-      has_nopin = (g_strcmp0(pin_required, "none") == 0);
-    } else if (g_strcmp0(key, "SubscriberIdentity") == 0) {
-      const gchar *subid = g_variant_get_string(value, NULL);
-      has_subscriberid = (subid && *subid);
-    } else if (g_strcmp0(key, "MobileCountryCode") == 0) {
-      const gchar *mcc = g_variant_get_string(value, NULL);
-      has_mcc = (mcc && *mcc);
-    } else if (g_strcmp0(key, "MobileNetworkCode") == 0) {
-      const gchar *mnc = g_variant_get_string(value, NULL);
-      has_mnc = (mnc && *mnc);
-    }
+    sim_properties_update(&slot->props, key, value);
+  }
+
+  g_variant_iter_free(iter);
+  g_variant_unref(result);
+
+  GINFO("Started monitoring SIM %u (path: %s)", slot->sim_index,
+        slot->modem_path);
+  sim_slot_evaluate(slot);
+  sim_slot_settled(slot);
+}
+
+static void sim_slot_start(SimSlot *slot, const gchar *modem_path) {
+  SimMonitor *monitor = slot->monitor;
+
+  slot->modem_path = g_strdup(modem_path);
+  GDEBUG("SIM %u mapped to modem path: %s", slot->sim_index,
+         slot->modem_path);
+
+  /* PropertyChanged of all modems is subscribed to already, from here on
+   * the signals of this one are routed to the slot */
+  g_hash_table_replace(monitor->paths, slot->modem_path, slot);
+  slot->monitoring = TRUE;
+  slot->state = SIM_MONITOR_STATE_GET_PROPERTIES;
+  slot->cancellable = g_cancellable_new();
+
+  /* Get current SIM properties */
+  g_dbus_connection_call(monitor->connection, OFONO_SERVICE, slot->modem_path,
+                         OFONO_SIM_MANAGER_IFACE, "GetProperties", NULL,
+                         G_VARIANT_TYPE("(a{sv})"), G_DBUS_CALL_FLAGS_NONE,
+                         OFONO_CALL_TIMEOUT, slot->cancellable,
+                         sim_slot_properties_ready, slot);
+}
+
+static void sim_slot_stop(SimSlot *slot) {
+  SimMonitor *monitor = slot->monitor;
+
+  slot->state = SIM_MONITOR_STATE_IDLE;
+  if (!slot->monitoring)
+    return;
+
+  sim_slot_cancel_evaluation(slot);
+
+  if (slot->cancellable) {
+    g_cancellable_cancel(slot->cancellable);
+    g_object_unref(slot->cancellable);
+    slot->cancellable = NULL;
   }
 
-  monitor->is_unlocked =
-      (has_present && has_cardidentifier && has_nopin &&
-       has_subscriberid && has_mcc && has_mnc);
+  g_hash_table_remove(monitor->paths, slot->modem_path);
+  g_free(slot->modem_path);
+  slot->modem_path = NULL;
+  memset(&slot->props, 0, sizeof(slot->props));
+  slot->is_unlocked = FALSE;
+  slot->monitoring = FALSE;
+
+  gchar *bursts = sim_slot_format_bursts(slot);
+  GINFO("Stopped monitoring SIM %u (%" G_GUINT64_FORMAT
+        " GetProperties round trips avoided, change bursts %s)",
+        slot->sim_index, slot->roundtrips_avoided, bursts);
+  g_free(bursts);
+}
 
-  GINFO("SIM %u current unlocked: %s", monitor->sim_index,
-        monitor->is_unlocked ? "YES" : "NO");
+static SimSlot *sim_monitor_find_slot(SimMonitor *monitor, guint sim_index) {
+  for (guint i = 0; i < monitor->n_slots; i++) {
+    if (monitor->slots[i].sim_index == sim_index)
+      return monitor->slots + i;
+  }
+  return NULL;
+}
 
+static void sim_monitor_modems_ready(GObject *source, GAsyncResult *res,
+                                     gpointer user_data) {
+  GError *error = NULL;
+  GVariant *result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source),
+                                                   res, &error);
+
+  if (!result && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+    /* monitor may be gone already */
+    g_error_free(error);
+    return;
+  }
+
+  SimMonitor *monitor = user_data;
+  monitor->state = SIM_MONITOR_STATE_IDLE;
+
+  if (!result) {
+    GERR("Failed to get available modems: %s", error->message);
+    g_error_free(error);
+    return;
+  }
+
+  GVariantIter *iter;
+  g_variant_get(result, "(ao)", &iter);
+
+  const gchar *path;
+  const gchar **moved = g_new0(const gchar *, monitor->n_slots);
+  guint index = 0;
+
+  /* One reply serves all slots, those that are monitored already keep
+   * going. Paths may move between slots, so all slots that change are
+   * stopped before any of them takes over its new path. */
+  while (g_variant_iter_next(iter, "&o", &path)) {
+    SimSlot *slot = sim_monitor_find_slot(monitor, index);
+    if (slot && g_strcmp0(slot->modem_path, path) != 0) {
+      sim_slot_stop(slot);
+      moved[slot - monitor->slots] = path;
+    }
+    index++;
+  }
+
+  for (guint i = 0; i < monitor->n_slots; i++) {
+    if (moved[i])
+      sim_slot_start(monitor->slots + i, moved[i]);
+  }
+
+  g_free(moved);
   g_variant_iter_free(iter);
   g_variant_unref(result);
+
+  monitor->state = SIM_MONITOR_STATE_MONITORING;
+  if (monitor->rescan) {
+    sim_monitor_resolve(monitor);
+    return;
+  }
+
+  for (guint i = 0; i < monitor->n_slots; i++) {
+    if (!monitor->slots[i].modem_path)
+      GWARN("SIM index %u not found in available modems, waiting for it",
+            monitor->slots[i].sim_index);
+  }
+}
+
+// GetAvailableModems, the reply maps modem paths to slots by position
+static void sim_monitor_resolve(SimMonitor *monitor) {
+  monitor->rescan = FALSE;
+  monitor->state = SIM_MONITOR_STATE_GET_MODEMS;
+
+  /* Get available modems from ofono */
+  g_dbus_connection_call(monitor->connection, OFONO_SERVICE,
+                         OFONO_MANAGER_PATH, OFONO_MANAGER_IFACE,
+                         "GetAvailableModems", NULL, G_VARIANT_TYPE("(ao)"),
+                         G_DBUS_CALL_FLAGS_NONE, OFONO_CALL_TIMEOUT,
+                         monitor->cancellable, sim_monitor_modems_ready,
+                         monitor);
+}
+
+static gboolean sim_monitor_all_resolved(SimMonitor *monitor) {
+  for (guint i = 0; i < monitor->n_slots; i++) {
+    if (!monitor->slots[i].modem_path)
+      return FALSE;
+  }
   return TRUE;
 }
 
-static void sim_monitor_property_changed(
+// Manager.ModemAdded and ModemRemoved. A removed modem stops its slot, an
+// added one is looked up again unless all slots are monitored.
+static void sim_monitor_modems_changed(
     GDBusConnection *connection, const gchar *sender_name,
     const gchar *object_path, const gchar *interface_name,
     const gchar *signal_name, GVariant *parameters, gpointer user_data) {
   SimMonitor *monitor = user_data;
+  const gchar *path;
 
-  if (g_strcmp0(interface_name, OFONO_SIM_MANAGER_IFACE) != 0 ||
-      g_strcmp0(signal_name, "PropertyChanged") != 0) {
+  if (!monitor->ofono_available || !monitor->n_slots)
     return;
+
+  if (g_strcmp0(signal_name, "ModemRemoved") == 0 &&
+      g_variant_is_of_type(parameters, G_VARIANT_TYPE("(o)"))) {
+    g_variant_get(parameters, "(&o)", &path);
+
+    SimSlot *slot = g_hash_table_lookup(monitor->paths, path);
+    if (slot) {
+      GINFO("Modem %s of SIM %u removed", path, slot->sim_index);
+      sim_slot_stop(slot);
+    }
+  } else if (g_strcmp0(signal_name, "ModemAdded") == 0 &&
+             g_variant_is_of_type(parameters, G_VARIANT_TYPE("(oa{sv})"))) {
+    g_variant_get(parameters, "(&o@a{sv})", &path, NULL);
+
+    if (g_hash_table_contains(monitor->paths, path) ||
+        sim_monitor_all_resolved(monitor))
+      return;
+
+    GINFO("Modem %s added", path);
+    if (monitor->state == SIM_MONITOR_STATE_GET_MODEMS)
+      monitor->rescan = TRUE;
+    else
+      sim_monitor_resolve(monitor);
   }
+}
 
-  /* Check if this signal is for our monitored modem */
-  if (!monitor->monitoring ||
-      g_strcmp0(monitor->modem_path, object_path) != 0) {
+// Resolves modem paths of all slots, the rest follows from there
+static void sim_monitor_discover(SimMonitor *monitor) {
+  gboolean cached = TRUE;
+
+  sim_monitor_stop(monitor);
+
+  for (guint i = 0; i < monitor->n_slots; i++)
+    cached &= (monitor->slots[i].cached_path != NULL);
+
+  // GetProperties on each path tells whether the cache is still good
+  if (cached) {
+    GDEBUG("Using cached modem paths");
+    monitor->state = SIM_MONITOR_STATE_MONITORING;
+    for (guint i = 0; i < monitor->n_slots; i++)
+      sim_slot_start(monitor->slots + i, monitor->slots[i].cached_path);
     return;
   }
 
-  const gchar *property_name;
-  GVariant *property_value;
-  g_variant_get(parameters, "(sv)", &property_name, &property_value);
+  sim_monitor_resolve(monitor);
+}
 
-  gchar *value_str = g_variant_print(property_value, TRUE);
-  GINFO("SIM property changed: %s -> %s", property_name, value_str);
-  g_free(value_str);
+static void sim_monitor_bus_ready(GObject *source, GAsyncResult *res,
+                                  gpointer user_data) {
+  GError *error = NULL;
+  GDBusConnection *connection = g_bus_get_finish(res, &error);
 
-  // list all properties that are checked in sim_monitor_get_current_properties
-  if (g_strcmp0(property_name, "Present") == 0 ||
-      g_strcmp0(property_name, "PinRequired") == 0 ||
-      g_strcmp0(property_name, "SubscriberIdentity") == 0 ||
-      g_strcmp0(property_name, "MobileCountryCode") == 0 ||
-      g_strcmp0(property_name, "MobileNetworkCode") == 0 ||
-      g_strcmp0(property_name, "CardIdentifier") == 0) {
-    gboolean was_unlocked = monitor->is_unlocked;
-
-    // update unlock properties
-    sim_monitor_get_current_properties(monitor);
-
-    /* Call callback when SIM becomes unlocked */
-    if (!was_unlocked && monitor->is_unlocked && monitor->sim_unlock_callback) {
-      GINFO("SIM %u unlocked, calling callback", monitor->sim_index);
-      monitor->sim_unlock_callback(monitor->user_data);
-    }
+  if (!connection && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+    /* monitor may be gone already */
+    g_error_free(error);
+    return;
   }
 
-  g_variant_unref(property_value);
+  SimMonitor *monitor = user_data;
+
+  if (!connection) {
+    GERR("Failed to connect to system D-Bus: %s", error->message);
+    g_error_free(error);
+    monitor->state = SIM_MONITOR_STATE_IDLE;
+    return;
+  }
+
+  monitor->connection = connection;
+  monitor->state = SIM_MONITOR_STATE_IDLE;
+
+  /* Subscribe before anything is queried so that nothing is lost in
+   * between. Signals are routed to slots by path. */
+  monitor->sim_signal_id = g_dbus_connection_signal_subscribe(
+      monitor->connection, OFONO_SERVICE, OFONO_SIM_MANAGER_IFACE,
+      "PropertyChanged", NULL, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+      sim_monitor_property_changed, monitor, NULL);
+  monitor->manager_signal_id = g_dbus_connection_signal_subscribe(
+      monitor->connection, OFONO_SERVICE, OFONO_MODEMS_IFACE, NULL,
+      OFONO_MANAGER_PATH, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+      sim_monitor_modems_changed, monitor, NULL);
+
+  /* Watch for ofono service availability */
+  monitor->name_watcher_id = g_bus_watch_name_on_connection(
+      monitor->connection, OFONO_SERVICE, G_BUS_NAME_WATCHER_FLAGS_NONE,
+      on_ofono_name_appeared, on_ofono_name_vanished, monitor, NULL);
+
+  GDEBUG("Connected to system D-Bus");
 }
 
 SimMonitor *
 sim_monitor_new(SimUnlockedCallback sim_unlock_callback,
+                SimSettledCallback sim_settled_callback,
                 OfonoAvailabilityCallback ofono_availability_callback,
                 gpointer user_data) {
-  GError *error = NULL;
-
   SimMonitor *monitor = g_new0(SimMonitor, 1);
   monitor->sim_unlock_callback = sim_unlock_callback;
+  monitor->sim_settled_callback = sim_settled_callback;
   monitor->ofono_availability_callback = ofono_availability_callback;
   monitor->user_data = user_data;
   monitor->ofono_available = FALSE;
-  monitor->sim_index = UINT_MAX; /* Invalid index initially */
-  monitor->is_unlocked = FALSE;
-  monitor->monitoring = FALSE;
+  monitor->cancellable = g_cancellable_new();
+  monitor->bus_cancellable = g_cancellable_new();
+  monitor->paths = g_hash_table_new(g_str_hash, g_str_equal);
 
-  /* Connect to system D-Bus */
-  monitor->connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
-  if (!monitor->connection) {
-    GERR("Failed to connect to system D-Bus: %s", error->message);
-    g_error_free(error);
-    sim_monitor_free(monitor);
-    return NULL;
-  }
-
-  /* Watch for ofono service availability */
-  monitor->name_watcher_id = g_bus_watch_name(
-      G_BUS_TYPE_SYSTEM, OFONO_SERVICE, G_BUS_NAME_WATCHER_FLAGS_NONE,
-      on_ofono_name_appeared, on_ofono_name_vanished, monitor, NULL);
+  /* Connect to system D-Bus, ofono is watched once connected */
+  monitor->state = SIM_MONITOR_STATE_CONNECTING;
+  g_bus_get(G_BUS_TYPE_SYSTEM, monitor->bus_cancellable,
+            sim_monitor_bus_ready, monitor);
 
   GINFO("SIM monitor initialized");
   return monitor;
 }
 
-gboolean sim_monitor_start(SimMonitor *monitor, guint sim_index) {
-  if (!monitor)
+static void sim_monitor_free_slots(SimMonitor *monitor) {
+  for (guint i = 0; i < monitor->n_slots; i++)
+    g_free(monitor->slots[i].cached_path);
+  g_free(monitor->slots);
+  monitor->slots = NULL;
+  monitor->n_slots = 0;
+}
+
+gboolean sim_monitor_start(SimMonitor *monitor, const guint *sim_indexes,
+                           const char *const *modem_paths, guint n_sims) {
+  if (!monitor || !n_sims)
     return FALSE;
 
   /* Stop any existing monitoring */
   sim_monitor_stop(monitor);
+  sim_monitor_free_slots(monitor);
+
+  monitor->slots = g_new0(SimSlot, n_sims);
+  monitor->n_slots = n_sims;
+  for (guint i = 0; i < n_sims; i++) {
+    SimSlot *slot = monitor->slots + i;
+
+    slot->monitor = monitor;
+    slot->sim_index = sim_indexes[i];
+    slot->state = SIM_MONITOR_STATE_IDLE;
+    if (modem_paths && modem_paths[i] && modem_paths[i][0])
+      slot->cached_path = g_strdup(modem_paths[i]);
+  }
 
   /* Check if ofono is available */
   if (!monitor->ofono_available) {
-    GDEBUG("ofono not available, storing target SIM index %u for later",
-           sim_index);
-    monitor->sim_index = sim_index;
+    GDEBUG("ofono not available, storing %u target SIM(s) for later", n_sims);
     return TRUE; /* Will start when ofono appears */
   }
 
-  monitor->sim_index = sim_index;
-
-  /* Get modem path for this SIM index */
-  if (!sim_monitor_get_modem_path(monitor, sim_index, &monitor->modem_path)) {
-    return FALSE;
-  }
+  sim_monitor_discover(monitor);
+  return TRUE;
+}
 
-  /* Get current properties */
-  if (!sim_monitor_get_current_properties(monitor)) {
-    GWARN("Could not get current properties for SIM %u, will monitor anyway",
-          sim_index);
-  }
+void sim_monitor_stop(SimMonitor *monitor) {
+  if (!monitor)
+    return;
 
-  /* Subscribe to PropertyChanged signals */
-  monitor->signal_id = g_dbus_connection_signal_subscribe(
-      monitor->connection, OFONO_SERVICE, OFONO_SIM_MANAGER_IFACE,
-      "PropertyChanged", monitor->modem_path, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
-      sim_monitor_property_changed, monitor, NULL);
+  if (monitor->state == SIM_MONITOR_STATE_GET_MODEMS)
+    sim_monitor_cancel_queries(monitor);
+  monitor->rescan = FALSE;
 
-  if (monitor->signal_id == 0) {
-    GERR("Failed to subscribe to PropertyChanged signals for SIM %u",
-         sim_index);
-    g_free(monitor->modem_path);
-    monitor->modem_path = NULL;
-    return FALSE;
-  }
+  if (monitor->state != SIM_MONITOR_STATE_CONNECTING)
+    monitor->state = SIM_MONITOR_STATE_IDLE;
 
-  monitor->monitoring = TRUE;
+  for (guint i = 0; i < monitor->n_slots; i++)
+    sim_slot_stop(monitor->slots + i);
+}
 
-  GINFO("Started monitoring SIM %u (path: %s, currently %s)", sim_index,
-        monitor->modem_path, monitor->is_unlocked ? "unlocked" : "locked");
+gboolean sim_monitor_is_unlocked(SimMonitor *monitor, guint sim_index) {
+  if (!monitor || !monitor->ofono_available)
+    return FALSE;
 
-  /* Call callback immediately if SIM is already unlocked */
-  if (monitor->is_unlocked && monitor->sim_unlock_callback) {
-    GINFO("SIM %u already unlocked, calling callback", sim_index);
-    monitor->sim_unlock_callback(monitor->user_data);
-  }
+  SimSlot *slot = sim_monitor_find_slot(monitor, sim_index);
+  if (!slot || !slot->monitoring)
+    return FALSE;
 
-  return TRUE;
+  return slot->is_unlocked;
 }
 
-void sim_monitor_stop(SimMonitor *monitor) {
-  if (!monitor || !monitor->monitoring)
-    return;
-
-  if (monitor->signal_id > 0) {
-    g_dbus_connection_signal_unsubscribe(monitor->connection,
-                                         monitor->signal_id);
-    monitor->signal_id = 0;
-  }
-
-  g_free(monitor->modem_path);
-  monitor->modem_path = NULL;
-  monitor->is_unlocked = FALSE;
-  monitor->monitoring = FALSE;
+gboolean sim_monitor_is_settled(SimMonitor *monitor, guint sim_index) {
+  if (!monitor || !monitor->ofono_available)
+    return FALSE;
 
-  GINFO("Stopped monitoring SIM %u", monitor->sim_index);
+  SimSlot *slot = sim_monitor_find_slot(monitor, sim_index);
+  return slot && slot->monitoring &&
+         slot->state == SIM_MONITOR_STATE_MONITORING;
 }
 
-gboolean sim_monitor_is_unlocked(SimMonitor *monitor) {
-  if (!monitor || !monitor->ofono_available || !monitor->monitoring)
-    return FALSE;
+const char *sim_monitor_modem_path(SimMonitor *monitor, guint sim_index) {
+  if (!monitor)
+    return NULL;
 
-  return monitor->is_unlocked;
+  SimSlot *slot = sim_monitor_find_slot(monitor, sim_index);
+  return slot ? slot->modem_path : NULL;
 }
 
 void sim_monitor_free(SimMonitor *monitor) {
@@ -329,14 +623,28 @@ void sim_monitor_free(SimMonitor *monitor) {
 
   sim_monitor_stop(monitor);
 
+  g_cancellable_cancel(monitor->bus_cancellable);
+  g_object_unref(monitor->bus_cancellable);
+  g_cancellable_cancel(monitor->cancellable);
+  g_object_unref(monitor->cancellable);
+
   if (monitor->name_watcher_id > 0) {
     g_bus_unwatch_name(monitor->name_watcher_id);
   }
 
+  if (monitor->sim_signal_id > 0)
+    g_dbus_connection_signal_unsubscribe(monitor->connection,
+                                         monitor->sim_signal_id);
+  if (monitor->manager_signal_id > 0)
+    g_dbus_connection_signal_unsubscribe(monitor->connection,
+                                         monitor->manager_signal_id);
+
   if (monitor->connection) {
     g_object_unref(monitor->connection);
   }
 
+  sim_monitor_free_slots(monitor);
+  g_hash_table_destroy(monitor->paths);
   g_free(monitor);
   GINFO("SIM monitor freed");
 }
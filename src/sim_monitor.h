@@ -12,9 +12,18 @@
 
 /**
  * Callback function called when SIM becomes unlocked
+ * @param sim_index: SIM slot that got unlocked
  * @param user_data: User data passed to sim_monitor_new()
  */
-typedef void (*SimUnlockedCallback)(gpointer user_data);
+typedef void (*SimUnlockedCallback)(guint sim_index, gpointer user_data);
+
+/**
+ * Callback function called once the initial properties of a SIM have been
+ * evaluated, after the unlock callback if they showed it unlocked
+ * @param sim_index: SIM slot whose status now comes from ofono
+ * @param user_data: User data passed to sim_monitor_new()
+ */
+typedef void (*SimSettledCallback)(guint sim_index, gpointer user_data);
 
 /**
  * Callback function called when ofono service appears/disappears
@@ -24,25 +33,90 @@ typedef void (*SimUnlockedCallback)(gpointer user_data);
 typedef void (*OfonoAvailabilityCallback)(gboolean available,
                                           gpointer user_data);
 
-typedef struct sim_monitor {
+/*
+ * Discovery states. Each step is an asynchronous D-Bus call, the next one is
+ * started from the completion of the previous one.
+ */
+typedef enum sim_monitor_state {
+  SIM_MONITOR_STATE_CONNECTING,      /* waiting for the system bus */
+  SIM_MONITOR_STATE_IDLE,            /* no SIM requested or no ofono */
+  SIM_MONITOR_STATE_GET_MODEMS,      /* GetAvailableModems in flight */
+  SIM_MONITOR_STATE_GET_PROPERTIES,  /* slot: initial GetProperties */
+  SIM_MONITOR_STATE_MONITORING       /* following PropertyChanged */
+} SimMonitorState;
+
+/*
+ * Cached SimManager properties that make up the unlock predicate. Seeded by
+ * the initial GetProperties and updated from PropertyChanged values.
+ */
+typedef struct sim_properties {
+  gboolean present;
+  gboolean card_identifier;
+  gboolean no_pin;
+  gboolean subscriber_identity;
+  gboolean mcc;
+  gboolean mnc;
+} SimProperties;
+
+/*
+ * PropertyChanged signals arrive in bursts while the card loads. Each one
+ * only updates the cache, the unlock predicate is evaluated once
+ * SIM_MONITOR_DEBOUNCE_MS after the first change of a burst. Burst sizes
+ * are counted in SIM_MONITOR_BURST_BUCKETS buckets, the last one takes all
+ * larger bursts.
+ */
+#define SIM_MONITOR_DEBOUNCE_MS 10
+#define SIM_MONITOR_BURST_BUCKETS 8
+
+typedef struct sim_monitor SimMonitor;
+
+/* State of one monitored SIM slot */
+typedef struct sim_slot {
+  SimMonitor *monitor;
+  guint sim_index;
+  gchar *modem_path;
+  gchar *cached_path; /* from the previous run, NULL once found stale */
+  SimMonitorState state; /* IDLE, GET_PROPERTIES or MONITORING */
+  gboolean is_unlocked;
+  GCancellable *cancellable; /* initial GetProperties */
+  gboolean monitoring;
+  SimProperties props;
+  guint64 roundtrips_avoided; /* changes served from the cache */
+  guint evaluate_id;          /* debounce timer */
+  guint burst;                /* changes since the last evaluation */
+  guint64 bursts[SIM_MONITOR_BURST_BUCKETS]; /* [n - 1]: bursts of n */
+} SimSlot;
+
+struct sim_monitor {
   GDBusConnection *connection;
+  GCancellable *bus_cancellable; /* bus acquisition */
+  GCancellable *cancellable;     /* ofono queries, reset when ofono vanishes */
+  SimMonitorState state;
   SimUnlockedCallback sim_unlock_callback;
+  SimSettledCallback sim_settled_callback;
   OfonoAvailabilityCallback ofono_availability_callback;
   gpointer user_data;
   guint name_watcher_id;
   gboolean ofono_available;
 
-  /* Single SIM state */
-  guint sim_index;
-  gchar *modem_path;
-  gboolean is_unlocked;
-  guint signal_id;
-  gboolean monitoring;
-} SimMonitor;
+  /* One subscription each for SimManager changes of all modems and for
+   * modems coming and going */
+  guint sim_signal_id;
+  guint manager_signal_id;
+  GHashTable *paths; /* modem path -> monitored SimSlot */
+  gboolean rescan;   /* modems changed during GetAvailableModems */
+
+  /* All slots are resolved from one GetAvailableModems reply */
+  SimSlot *slots;
+  guint n_slots;
+};
 
 /**
- * Create new SIM monitor
+ * Create new SIM monitor. The system bus is acquired asynchronously, failure
+ * to connect is logged and leaves the monitor idle.
  * @param sim_unlock_callback: Function to call when SIM becomes unlocked
+ * @param sim_settled_callback: Function to call when the status of a SIM
+ * has been queried (can be NULL)
  * @param ofono_availability_callback: Function to call when ofono
  * appears/disappears (can be NULL)
  * @param user_data: User data passed to callbacks
@@ -50,19 +124,27 @@ typedef struct sim_monitor {
  */
 SimMonitor *
 sim_monitor_new(SimUnlockedCallback sim_unlock_callback,
+                SimSettledCallback sim_settled_callback,
                 OfonoAvailabilityCallback ofono_availability_callback,
                 gpointer user_data);
 
 /**
- * Start monitoring specific SIM slot
+ * Start monitoring SIM slots. Modem lookup and the initial property queries
+ * run asynchronously once ofono is available. If modem paths are known for
+ * all slots, GetAvailableModems is skipped. A path that turns out to be
+ * stale brings the lookup back.
  * @param monitor: SimMonitor instance
- * @param sim_index: SIM slot to monitor (0, 1, 2, ...)
- * @return: TRUE on success, FALSE on failure
+ * @param sim_indexes: SIM slots to monitor (0, 1, 2, ...)
+ * @param modem_paths: Known modem paths of the slots (can be NULL, entries
+ * can be NULL)
+ * @param n_sims: Number of entries in sim_indexes
+ * @return: TRUE if the request was accepted, FALSE on failure
  */
-gboolean sim_monitor_start(SimMonitor *monitor, guint sim_index);
+gboolean sim_monitor_start(SimMonitor *monitor, const guint *sim_indexes,
+                           const char *const *modem_paths, guint n_sims);
 
 /**
- * Stop monitoring SIM
+ * Stop monitoring all SIM slots
  * @param monitor: SimMonitor instance
  */
 void sim_monitor_stop(SimMonitor *monitor);
@@ -70,10 +152,26 @@ void sim_monitor_stop(SimMonitor *monitor);
 /**
  * Check current unlock status of monitored SIM
  * @param monitor: SimMonitor instance
+ * @param sim_index: SIM slot to check
  * @return: TRUE if SIM is unlocked, FALSE if locked, not monitoring, or ofono
  * unavailable
  */
-gboolean sim_monitor_is_unlocked(SimMonitor *monitor);
+gboolean sim_monitor_is_unlocked(SimMonitor *monitor, guint sim_index);
+
+/**
+ * Check whether the unlock status of the SIM comes from ofono
+ * @param monitor: SimMonitor instance
+ * @param sim_index: SIM slot to check
+ * @return: TRUE once the initial properties of the SIM have been queried
+ */
+gboolean sim_monitor_is_settled(SimMonitor *monitor, guint sim_index);
+
+/**
+ * @param monitor: SimMonitor instance
+ * @param sim_index: SIM slot
+ * @return: Modem path of the SIM or NULL if it is not monitored
+ */
+const char *sim_monitor_modem_path(SimMonitor *monitor, guint sim_index);
 
 /**
  * Free SimMonitor and cleanup resources
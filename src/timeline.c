@@ -0,0 +1,62 @@
+/*
+ * Boot phase timeline of one oemhook instance
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "timeline.h"
+
+static const char *const app_phase_names[APP_PHASE_COUNT] = {
+    [APP_PHASE_START] = "start",         [APP_PHASE_APPEARED] = "appeared",
+    [APP_PHASE_CONNECTED] = "connected", [APP_PHASE_CALLBACKS] = "callbacks",
+    [APP_PHASE_OFONO] = "ofono",         [APP_PHASE_UNLOCKED] = "unlocked",
+    [APP_PHASE_ATEL] = "atel-ready",
+};
+
+const char *app_phase_name(AppPhase phase) {
+  return phase < APP_PHASE_COUNT ? app_phase_names[phase] : "unknown";
+}
+
+void app_timeline_mark(AppTimeline *timeline, AppPhase phase, gint64 now) {
+  if (!timeline->first[phase])
+    timeline->first[phase] = now;
+  timeline->last[phase] = now;
+  timeline->count[phase]++;
+}
+
+static double app_timeline_ms(gint64 span) {
+  return (double)span / G_TIME_SPAN_MILLISECOND;
+}
+
+void app_timeline_format(const AppTimeline *timeline, const char *name,
+                         GString *out) {
+  const gint64 start = timeline->first[APP_PHASE_START];
+  gint64 prev = start;
+  guint order[APP_PHASE_COUNT];
+  guint n = 0;
+
+  // reached milestones sorted by first occurrence, there are only a few
+  for (guint i = 0; i < APP_PHASE_COUNT; i++) {
+    guint k;
+
+    if (!timeline->first[i])
+      continue;
+    for (k = n++;
+         k > 0 && timeline->first[order[k - 1]] > timeline->first[i]; k--)
+      order[k] = order[k - 1];
+    order[k] = i;
+  }
+
+  for (guint i = 0; i < n; i++) {
+    const AppPhase phase = order[i];
+    const gint64 first = timeline->first[phase];
+
+    g_string_append_printf(out, "%s %s %.3f %.3f %.3f %u\n", name,
+                           app_phase_name(phase),
+                           app_timeline_ms(first - start),
+                           app_timeline_ms(first - prev),
+                           app_timeline_ms(timeline->last[phase] - start),
+                           timeline->count[phase]);
+    prev = first;
+  }
+}
@@ -0,0 +1,56 @@
+/*
+ * Boot phase timeline of one oemhook instance
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <glib.h>
+
+// Milestones on the way to SMS readiness. They are not strictly ordered:
+// oFono and the SIM may well be ready before the remote appears.
+typedef enum app_phase {
+  APP_PHASE_START,     /* monitoring started */
+  APP_PHASE_APPEARED,  /* remote registered */
+  APP_PHASE_CONNECTED, /* remote connected */
+  APP_PHASE_CALLBACKS, /* setCallback completed */
+  APP_PHASE_OFONO,     /* oFono available */
+  APP_PHASE_UNLOCKED,  /* SIM unlocked */
+  APP_PHASE_ATEL,      /* ATEL ready completed */
+  APP_PHASE_COUNT
+} AppPhase;
+
+typedef struct app_timeline {
+  gint64 first[APP_PHASE_COUNT]; /* monotonic, 0 if not reached */
+  gint64 last[APP_PHASE_COUNT];
+  guint count[APP_PHASE_COUNT];
+} AppTimeline;
+
+/**
+ * Record a milestone
+ * @param timeline: Timeline of the instance
+ * @param phase: Milestone reached
+ * @param now: Current monotonic time
+ */
+void app_timeline_mark(AppTimeline *timeline, AppPhase phase, gint64 now);
+
+/**
+ * Append the timeline as one line per reached milestone, in the order they
+ * were first reached:
+ *   <name> <phase> <since start, ms> <since previous milestone, ms>
+ *   <last since start, ms> <count>
+ * @param timeline: Timeline of the instance
+ * @param name: Instance name to prefix the lines with
+ * @param out: String to append to
+ */
+void app_timeline_format(const AppTimeline *timeline, const char *name,
+                         GString *out);
+
+/**
+ * @return: Short name of the phase
+ */
+const char *app_phase_name(AppPhase phase);
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ * Transport between the tunnel and qcrilNrd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "transport.h"
+
+void transport_free(Transport *transport) {
+  if (transport)
+    transport->ops->free(transport);
+}
+
+TransportLink *transport_link_new(Transport *transport, const char *name,
+                                  const TransportHandlers *handlers,
+                                  gpointer user_data) {
+  TransportLink *link = transport->ops->link_new(transport, name);
+
+  link->transport = transport;
+  link->name = g_strdup(name);
+  link->handlers = handlers;
+  link->user_data = user_data;
+  return link;
+}
+
+void transport_link_free(TransportLink *link) {
+  if (link) {
+    char *name = link->name;
+
+    link->transport->ops->link_free(link);
+    g_free(name);
+  }
+}
+
+gboolean transport_link_connect(TransportLink *link) {
+  return link->transport->ops->connect(link);
+}
+
+void transport_link_disconnect(TransportLink *link) {
+  link->transport->ops->disconnect(link);
+}
+
+gulong transport_link_set_callback(TransportLink *link,
+                                   TransportReplyFunc func,
+                                   gpointer user_data, GDestroyNotify destroy) {
+  return link->transport->ops->set_callback(link, func, user_data, destroy);
+}
+
+gulong transport_link_raw_request(TransportLink *link, gint32 serial,
+                                  const void *data, gsize size,
+                                  TransportReplyFunc func, gpointer user_data,
+                                  GDestroyNotify destroy) {
+  return link->transport->ops->raw_request(link, serial, data, size, func,
+                                           user_data, destroy);
+}
+
+void transport_link_cancel(TransportLink *link, gulong id) {
+  if (id)
+    link->transport->ops->cancel(link, id);
+}
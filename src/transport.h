@@ -0,0 +1,167 @@
+/*
+ * Transport between the tunnel and qcrilNrd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <glib.h>
+
+#define TRANSPORT_STATUS_OK (0)
+#define TRANSPORT_STATUS_FAILED (-1)
+#define TRANSPORT_STATUS_DEAD (-32)
+#define TRANSPORT_STATUS_TIMEOUT (-110)
+
+typedef struct transport Transport;
+typedef struct transport_link TransportLink;
+
+/**
+ * Completion of a transaction
+ * @param link: Link the transaction was sent over
+ * @param status: TRANSPORT_STATUS_OK on success
+ * @param data: Reply payload (can be NULL), valid only during the call
+ * @param size: Reply payload size in bytes
+ * @param user_data: User data passed with the transaction
+ */
+typedef void (*TransportReplyFunc)(TransportLink *link, int status,
+                                   const void *data, gsize size,
+                                   gpointer user_data);
+
+/* Events delivered from the remote, all of them from the main loop */
+typedef struct transport_handlers {
+  /* remote service has been registered */
+  void (*appeared)(TransportLink *link, gpointer user_data);
+  /* transport_link_connect() has completed */
+  void (*connected)(TransportLink *link, gboolean ok, gpointer user_data);
+  /* remote has died */
+  void (*died)(TransportLink *link, gpointer user_data);
+  /* QCOM_HOOK_RESPONSE_RAW */
+  void (*response)(TransportLink *link, gint32 serial, gint32 err,
+                   const void *data, gsize size, gpointer user_data);
+  /* QCOM_HOOK_INDICATION_RAW */
+  void (*indication)(TransportLink *link, const void *data, gsize size,
+                     gpointer user_data);
+} TransportHandlers;
+
+/* Backend implementation */
+typedef struct transport_ops {
+  const char *name;
+  void (*free)(Transport *transport);
+  TransportLink *(*link_new)(Transport *transport, const char *name);
+  void (*link_free)(TransportLink *link);
+  gboolean (*connect)(TransportLink *link);
+  void (*disconnect)(TransportLink *link);
+  gulong (*set_callback)(TransportLink *link, TransportReplyFunc func,
+                         gpointer user_data, GDestroyNotify destroy);
+  gulong (*raw_request)(TransportLink *link, gint32 serial, const void *data,
+                        gsize size, TransportReplyFunc func,
+                        gpointer user_data, GDestroyNotify destroy);
+  void (*cancel)(TransportLink *link, gulong id);
+} TransportOps;
+
+/* Shared by all links of the backend */
+struct transport {
+  const TransportOps *ops;
+};
+
+/* Connection to one remote instance, extended by the backend */
+struct transport_link {
+  Transport *transport;
+  char *name;
+  const TransportHandlers *handlers;
+  gpointer user_data;
+};
+
+/**
+ * Create binder backend. Only available when built with libgbinder.
+ * @param device: Binder device
+ * @param iface: Remote interface
+ * @param resp_iface: Interface of the local response object
+ * @param ind_iface: Interface of the local indication object
+ * @return: Transport or NULL on failure
+ */
+Transport *transport_gbinder_new(const char *device, const char *iface,
+                                 const char *resp_iface,
+                                 const char *ind_iface);
+
+/**
+ * Create loopback backend with in-process qcrilNrd emulation. Requests are
+ * exchanged with the emulated remote over a socketpair.
+ * @param reply_delay_ms: Delay before the emulated remote answers
+ * @param ind_interval_ms: Period of emulated indications, 0 to disable
+ * @param lifetime_ms: The emulated remote dies this long after each
+ * connection and registers again, 0 to keep it alive
+ * @return: Transport or NULL on failure
+ */
+Transport *transport_loopback_new(guint reply_delay_ms, guint ind_interval_ms,
+                                  guint lifetime_ms);
+
+/**
+ * Free transport, all links must be freed before
+ * @param transport: Transport instance
+ */
+void transport_free(Transport *transport);
+
+/**
+ * Create link to remote instance and start waiting for its registration
+ * @param transport: Transport instance
+ * @param name: Remote instance name
+ * @param handlers: Event handlers
+ * @param user_data: User data passed to handlers
+ * @return: Link instance
+ */
+TransportLink *transport_link_new(Transport *transport, const char *name,
+                                  const TransportHandlers *handlers,
+                                  gpointer user_data);
+
+/**
+ * Free link, cancelling all transactions in flight
+ * @param link: Link instance (can be NULL)
+ */
+void transport_link_free(TransportLink *link);
+
+/**
+ * Start connecting to the remote, dropping the previous connection if any.
+ * The outcome is reported to the connected handler.
+ * @param link: Link instance
+ * @return: FALSE if connecting could not be started
+ */
+gboolean transport_link_connect(TransportLink *link);
+
+/**
+ * Drop the connection or the connection attempt. Transactions in flight are
+ * cancelled, local objects are kept for the next connection.
+ * @param link: Link instance
+ */
+void transport_link_disconnect(TransportLink *link);
+
+/**
+ * Register response and indication callbacks with the remote. If 0 is
+ * returned, neither func nor destroy is called.
+ * @return: Transaction id or 0 if it could not be submitted
+ */
+gulong transport_link_set_callback(TransportLink *link,
+                                   TransportReplyFunc func,
+                                   gpointer user_data, GDestroyNotify destroy);
+
+/**
+ * Send raw OEM hook request. If 0 is returned, neither func nor destroy is
+ * called.
+ * @return: Transaction id or 0 if it could not be submitted
+ */
+gulong transport_link_raw_request(TransportLink *link, gint32 serial,
+                                  const void *data, gsize size,
+                                  TransportReplyFunc func, gpointer user_data,
+                                  GDestroyNotify destroy);
+
+/**
+ * Cancel transaction in flight. The reply function is not called but
+ * destroy notification is.
+ * @param link: Link instance
+ * @param id: Transaction id
+ */
+void transport_link_cancel(TransportLink *link, gulong id);
+
+#endif
@@ -0,0 +1,391 @@
+/*
+ * Copyright (C) 2018 Jolla Ltd.
+ * Copyright (C) 2018 Slava Monich <slava.monich@jolla.com>
+ * Copyright (C) 2025 Rinigus https://github.com/rinigus
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "transport.h"
+
+#include <gbinder.h>
+#include <gutil_log.h>
+
+#define TRANSACTION_setCallback 1
+#define TRANSACTION_OEMHOOK_RAW_REQUEST 2
+
+#define QCOM_HOOK_RESPONSE_RAW 1
+#define QCOM_HOOK_INDICATION_RAW 1
+
+typedef struct transport_gbinder {
+  Transport parent;
+  GBinderServiceManager *sm;
+  GBinderLocalObject *local;
+  char *iface;
+  char *resp_iface;
+  char *ind_iface;
+} TransportGBinder;
+
+typedef struct transport_gbinder_link {
+  TransportLink parent;
+  GBinderRemoteObject *remote;
+  gulong wait_id;
+  gulong get_id; /* get_service in flight */
+  gulong death_id;
+  GBinderClient *client;
+  GHashTable *txs; /* id => TransportGBinderTx in flight on the client */
+  GBinderLocalObject *resp;
+  GBinderLocalObject *ind;
+} TransportGBinderLink;
+
+typedef struct transport_gbinder_tx {
+  TransportLink *link;
+  gulong id;
+  TransportReplyFunc func;
+  gpointer user_data;
+  GDestroyNotify destroy;
+} TransportGBinderTx;
+
+static inline TransportGBinder *gbinder_transport(Transport *transport) {
+  return (TransportGBinder *)transport;
+}
+
+static inline TransportGBinderLink *gbinder_link(TransportLink *link) {
+  return (TransportGBinderLink *)link;
+}
+
+static void dump_data(const GBinderReader *reader, const char *prefix) {
+  const int level = GLOG_LEVEL_DEFAULT;
+  gsize size = 0;
+  const guint8 *data = gbinder_reader_get_data(reader, &size);
+
+  if (data && size > 0) {
+    gutil_log_dump(&gutil_log_default, level, prefix ? prefix : "  ", data,
+                   size);
+    GINFO("data dumped above: size=%zu", size);
+  } else {
+    GINFO("(no data)");
+  }
+}
+
+static GBinderLocalReply *resp_tx_handler(GBinderLocalObject *obj,
+                                          GBinderRemoteRequest *req, guint code,
+                                          guint flags, int *status,
+                                          void *user_data) {
+  TransportLink *link = user_data;
+  GBinderReader reader;
+  gbinder_remote_request_init_reader(req, &reader);
+
+  // GINFO("Response transaction %u received", code);
+  // dump_data(&reader, "    ");
+
+  if (code == QCOM_HOOK_RESPONSE_RAW) {
+    gint32 serial = 0;
+    gint32 err = 0;
+    gsize len, elemsize;
+    const void *data;
+    if (gbinder_reader_read_int32(&reader, &serial) &&
+        gbinder_reader_read_int32(&reader, &err)) {
+      data = gbinder_reader_read_hidl_vec(&reader, &len, &elemsize);
+      link->handlers->response(link, serial, err, data, len * elemsize,
+                               link->user_data);
+    } else {
+      GERR("Error while reading response transaction %u", code);
+    }
+
+  } else {
+    GINFO("Unhandled response transaction %u", code);
+  }
+
+  *status = GBINDER_STATUS_OK;
+  return NULL;
+}
+
+static GBinderLocalReply *ind_tx_handler(GBinderLocalObject *obj,
+                                         GBinderRemoteRequest *req, guint code,
+                                         guint flags, int *status,
+                                         void *user_data) {
+  TransportLink *link = user_data;
+  GBinderReader reader;
+  gbinder_remote_request_init_reader(req, &reader);
+
+  // dump_data(&reader, "ind    ");
+
+  if (code == QCOM_HOOK_INDICATION_RAW) {
+    gsize len, elemsize;
+    const void *data = gbinder_reader_read_hidl_vec(&reader, &len, &elemsize);
+
+    link->handlers->indication(link, data, len * elemsize, link->user_data);
+  } else {
+    GINFO("Unhandled indication transaction %u", code);
+  }
+
+  *status = GBINDER_STATUS_OK;
+  return NULL;
+}
+
+static void transport_gbinder_registration_handler(GBinderServiceManager *sm,
+                                                   const char *name,
+                                                   void *user_data) {
+  TransportLink *link = user_data;
+
+  if (!strcmp(name, link->name))
+    link->handlers->appeared(link, link->user_data);
+}
+
+static void transport_gbinder_remote_died(GBinderRemoteObject *obj,
+                                          void *user_data) {
+  TransportLink *link = user_data;
+
+  link->handlers->died(link, link->user_data);
+}
+
+static void transport_gbinder_tx_free(gpointer data) {
+  TransportGBinderTx *tx = data;
+
+  if (tx->id)
+    g_hash_table_remove(gbinder_link(tx->link)->txs, GSIZE_TO_POINTER(tx->id));
+
+  if (tx->destroy)
+    tx->destroy(tx->user_data);
+  g_free(tx);
+}
+
+static void transport_gbinder_reply(GBinderClient *client,
+                                    GBinderRemoteReply *reply, int status,
+                                    void *user_data) {
+  TransportGBinderTx *tx = user_data;
+  const void *data = NULL;
+  gsize len = 0, elemsz = 0;
+
+  if (status == GBINDER_STATUS_OK && reply) {
+    GBinderReader reader;
+
+    gbinder_remote_reply_init_reader(reply, &reader);
+    data = gbinder_reader_read_hidl_vec(&reader, &len, &elemsz);
+  }
+
+  if (tx->func)
+    tx->func(tx->link, status == GBINDER_STATUS_OK ? TRANSPORT_STATUS_OK
+                                                   : status,
+             data, len * elemsz, tx->user_data);
+}
+
+static gulong transport_gbinder_transact(TransportLink *link, guint32 code,
+                                         GBinderLocalRequest *req,
+                                         TransportReplyFunc func,
+                                         gpointer user_data,
+                                         GDestroyNotify destroy) {
+  TransportGBinderLink *self = gbinder_link(link);
+  TransportGBinderTx *tx = g_new0(TransportGBinderTx, 1);
+
+  tx->link = link;
+  tx->func = func;
+  tx->user_data = user_data;
+  tx->destroy = destroy;
+
+  gulong id = gbinder_client_transact(self->client, code, 0, req,
+                                      transport_gbinder_reply,
+                                      transport_gbinder_tx_free, tx);
+  if (!id) {
+    g_free(tx); /* caller keeps ownership of user_data */
+  } else {
+    tx->id = id;
+    g_hash_table_insert(self->txs, GSIZE_TO_POINTER(id), tx);
+  }
+  return id;
+}
+
+static TransportLink *transport_gbinder_link_new(Transport *transport,
+                                                 const char *name) {
+  TransportGBinder *self = gbinder_transport(transport);
+  TransportGBinderLink *link = g_new0(TransportGBinderLink, 1);
+
+  link->txs = g_hash_table_new(g_direct_hash, g_direct_equal);
+  link->wait_id = gbinder_servicemanager_add_registration_handler(
+      self->sm, name, transport_gbinder_registration_handler, link);
+  return &link->parent;
+}
+
+// Releases everything tied to the remote instance
+static void transport_gbinder_disconnect(TransportLink *link) {
+  TransportGBinder *transport = gbinder_transport(link->transport);
+  TransportGBinderLink *self = gbinder_link(link);
+
+  if (self->get_id) {
+    gbinder_servicemanager_cancel(transport->sm, self->get_id);
+    self->get_id = 0;
+  }
+
+  if (g_hash_table_size(self->txs)) {
+    GHashTableIter it;
+    gpointer value;
+
+    // destroy may come later, by then the link may be gone
+    g_hash_table_iter_init(&it, self->txs);
+    while (g_hash_table_iter_next(&it, NULL, &value)) {
+      TransportGBinderTx *tx = value;
+      const gulong id = tx->id;
+
+      tx->id = 0;
+      gbinder_client_cancel(self->client, id);
+    }
+    g_hash_table_remove_all(self->txs);
+  }
+
+  gbinder_client_unref(self->client);
+  self->client = NULL;
+  gbinder_remote_object_remove_handler(self->remote, self->death_id);
+  self->death_id = 0;
+  gbinder_remote_object_unref(self->remote);
+  self->remote = NULL;
+}
+
+static void transport_gbinder_link_free(TransportLink *link) {
+  TransportGBinder *transport = gbinder_transport(link->transport);
+  TransportGBinderLink *self = gbinder_link(link);
+
+  transport_gbinder_disconnect(link);
+  gbinder_servicemanager_remove_handler(transport->sm, self->wait_id);
+  gbinder_local_object_drop(self->resp);
+  gbinder_local_object_drop(self->ind);
+  g_hash_table_destroy(self->txs);
+  g_free(self);
+}
+
+static void transport_gbinder_got_service(GBinderServiceManager *sm,
+                                          GBinderRemoteObject *obj,
+                                          int status, void *user_data) {
+  TransportLink *link = user_data;
+  TransportGBinder *transport = gbinder_transport(link->transport);
+  TransportGBinderLink *self = gbinder_link(link);
+
+  self->get_id = 0;
+  if (!obj) {
+    GWARN("Failed to get %s, status %d", link->name, status);
+    link->handlers->connected(link, FALSE, link->user_data);
+    return;
+  }
+
+  // the instance may have died between the lookup and the reply, its death
+  // would never be reported
+  if (gbinder_remote_object_is_dead(obj)) {
+    GWARN("%s is already dead", link->name);
+    link->handlers->connected(link, FALSE, link->user_data);
+    return;
+  }
+
+  GINFO("Connected to %s", link->name);
+  self->remote = gbinder_remote_object_ref(obj);
+  self->client = gbinder_client_new(self->remote, transport->iface);
+  self->death_id = gbinder_remote_object_add_death_handler(
+      self->remote, transport_gbinder_remote_died, link);
+  link->handlers->connected(link, TRUE, link->user_data);
+}
+
+static gboolean transport_gbinder_connect(TransportLink *link) {
+  TransportGBinder *transport = gbinder_transport(link->transport);
+  TransportGBinderLink *self = gbinder_link(link);
+
+  transport_gbinder_disconnect(link);
+  self->get_id = gbinder_servicemanager_get_service(
+      transport->sm, link->name, transport_gbinder_got_service, link);
+  return self->get_id != 0;
+}
+
+static gulong transport_gbinder_set_callback(TransportLink *link,
+                                             TransportReplyFunc func,
+                                             gpointer user_data,
+                                             GDestroyNotify destroy) {
+  TransportGBinder *transport = gbinder_transport(link->transport);
+  TransportGBinderLink *self = gbinder_link(link);
+  GBinderLocalRequest *req = gbinder_client_new_request(self->client);
+
+  if (!req)
+    return 0;
+
+  if (!self->resp)
+    self->resp = gbinder_servicemanager_new_local_object(
+        transport->sm, transport->resp_iface, resp_tx_handler, link);
+  if (!self->ind)
+    self->ind = gbinder_servicemanager_new_local_object(
+        transport->sm, transport->ind_iface, ind_tx_handler, link);
+
+  // write the two strong binder objects into the request:
+  gbinder_local_request_append_local_object(req, self->resp);
+  gbinder_local_request_append_local_object(req, self->ind);
+
+  gulong id = transport_gbinder_transact(link, TRANSACTION_setCallback, req,
+                                         func, user_data, destroy);
+  gbinder_local_request_unref(req);
+  return id;
+}
+
+static gulong transport_gbinder_raw_request(TransportLink *link, gint32 serial,
+                                            const void *data, gsize size,
+                                            TransportReplyFunc func,
+                                            gpointer user_data,
+                                            GDestroyNotify destroy) {
+  TransportGBinderLink *self = gbinder_link(link);
+  GBinderLocalRequest *req = gbinder_client_new_request(self->client);
+  GBinderWriter writer;
+
+  if (!req)
+    return 0;
+
+  gbinder_local_request_init_writer(req, &writer);
+  gbinder_writer_append_int32(&writer, serial);
+  gbinder_writer_append_hidl_vec(&writer, data, size, sizeof(gint8));
+
+  gulong id = transport_gbinder_transact(link, TRANSACTION_OEMHOOK_RAW_REQUEST,
+                                         req, func, user_data, destroy);
+  gbinder_local_request_unref(req);
+  return id;
+}
+
+static void transport_gbinder_cancel(TransportLink *link, gulong id) {
+  gbinder_client_cancel(gbinder_link(link)->client, id);
+}
+
+static void transport_gbinder_free(Transport *transport) {
+  TransportGBinder *self = gbinder_transport(transport);
+
+  gbinder_local_object_drop(self->local);
+  gbinder_servicemanager_unref(self->sm);
+  g_free(self->iface);
+  g_free(self->resp_iface);
+  g_free(self->ind_iface);
+  g_free(self);
+}
+
+static const TransportOps transport_gbinder_ops = {
+    .name = "gbinder",
+    .free = transport_gbinder_free,
+    .link_new = transport_gbinder_link_new,
+    .link_free = transport_gbinder_link_free,
+    .connect = transport_gbinder_connect,
+    .disconnect = transport_gbinder_disconnect,
+    .set_callback = transport_gbinder_set_callback,
+    .raw_request = transport_gbinder_raw_request,
+    .cancel = transport_gbinder_cancel,
+};
+
+Transport *transport_gbinder_new(const char *device, const char *iface,
+                                 const char *resp_iface,
+                                 const char *ind_iface) {
+  GBinderServiceManager *sm = gbinder_servicemanager_new(device);
+
+  if (!sm) {
+    GERR("Failed to create service manager for device: %s", device);
+    return NULL;
+  }
+
+  TransportGBinder *self = g_new0(TransportGBinder, 1);
+  self->parent.ops = &transport_gbinder_ops;
+  self->sm = sm;
+  self->local = gbinder_servicemanager_new_local_object(sm, NULL, NULL, NULL);
+  self->iface = g_strdup(iface);
+  self->resp_iface = g_strdup(resp_iface);
+  self->ind_iface = g_strdup(ind_iface);
+  return &self->parent;
+}
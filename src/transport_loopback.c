@@ -0,0 +1,540 @@
+/*
+ * Loopback transport with in-process qcrilNrd emulation
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "transport.h"
+
+#include "oemhook.h"
+
+#include <gutil_log.h>
+
+#include <glib-unix.h>
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+ * Messages are exchanged over a SOCK_SEQPACKET socketpair, one record per
+ * message: header followed by the payload. The tunnel end of the pair
+ * behaves like the binder client, the other end like qcrilNrd. Both ends
+ * are served by the main loop, so the sockets are non-blocking and records
+ * that do not fit wait in a queue until the peer has read.
+ */
+#define LOOPBACK_PAYLOAD_MAX (64 * 1024)
+#define LOOPBACK_IND_SIZE 256
+#define LOOPBACK_RESTART_MS 100
+
+typedef enum loopback_msg_type {
+  LOOPBACK_SET_CALLBACK = 1, /* tunnel -> remote */
+  LOOPBACK_RAW_REQUEST,      /* tunnel -> remote */
+  LOOPBACK_REPLY,            /* remote -> tunnel, completes transaction */
+  LOOPBACK_RESPONSE,         /* remote -> tunnel, QCOM_HOOK_RESPONSE_RAW */
+  LOOPBACK_INDICATION        /* remote -> tunnel, QCOM_HOOK_INDICATION_RAW */
+} LoopbackMsgType;
+
+typedef struct loopback_msg_header {
+  guint32 type;
+  guint32 id; /* transaction id, echoed in the reply */
+  gint32 serial;
+  gint32 status; /* reply status or response error */
+  guint32 size;  /* payload size */
+} LoopbackMsgHeader;
+
+typedef struct transport_loopback {
+  Transport parent;
+  guint reply_delay_ms;
+  guint ind_interval_ms;
+  guint lifetime_ms;
+  gulong last_id;
+} TransportLoopback;
+
+enum { LOOPBACK_TUNNEL, LOOPBACK_REMOTE };
+
+typedef struct transport_loopback_link {
+  TransportLink parent;
+  int fd[2];
+  guint watch_id[2];
+  guint out_id[2]; /* until the queue has been written */
+  GQueue out[2];   /* LoopbackOut */
+  guint appear_id;
+  guint connect_id;
+  guint ind_id;
+  guint die_id;
+  GHashTable *pending; /* id => LoopbackTx */
+  GSList *delayed;     /* LoopbackDelayed */
+  gboolean registered; /* the emulated service can be connected to */
+  gboolean callbacks_set;
+  guint32 ind_count;
+  guint8 *buf; /* receive buffer, shared by both ends */
+} TransportLoopbackLink;
+
+typedef struct loopback_tx {
+  TransportReplyFunc func;
+  gpointer user_data;
+  GDestroyNotify destroy;
+} LoopbackTx;
+
+// Record waiting for room in the socket
+typedef struct loopback_out {
+  LoopbackMsgHeader header;
+  guint8 data[];
+} LoopbackOut;
+
+// Remote message waiting for the emulated reply delay
+typedef struct loopback_delayed {
+  TransportLoopbackLink *link;
+  guint id;
+  LoopbackMsgHeader header;
+} LoopbackDelayed;
+
+static inline TransportLoopback *loopback_transport(Transport *transport) {
+  return (TransportLoopback *)transport;
+}
+
+static inline TransportLoopbackLink *loopback_link(TransportLink *link) {
+  return (TransportLoopbackLink *)link;
+}
+
+static void loopback_tx_free(gpointer data) {
+  LoopbackTx *tx = data;
+
+  if (tx->destroy)
+    tx->destroy(tx->user_data);
+  g_free(tx);
+}
+
+static ssize_t loopback_sendmsg(int fd, const LoopbackMsgHeader *header,
+                                const void *data) {
+  struct iovec iov[2] = {{(void *)header, sizeof(*header)},
+                         {(void *)data, header->size}};
+  struct msghdr msg = {.msg_iov = iov, .msg_iovlen = data ? 2 : 1};
+
+  return sendmsg(fd, &msg, MSG_NOSIGNAL);
+}
+
+static gboolean loopback_flush(TransportLoopbackLink *self, int end) {
+  GQueue *queue = self->out + end;
+  LoopbackOut *out;
+
+  while ((out = g_queue_peek_head(queue))) {
+    if (loopback_sendmsg(self->fd[end], &out->header,
+                         out->header.size ? out->data : NULL) < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return G_SOURCE_CONTINUE;
+      GERR("loopback send failed: %s", g_strerror(errno));
+    }
+    g_free(g_queue_pop_head(queue));
+  }
+
+  self->out_id[end] = 0;
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean loopback_tunnel_output(gint fd, GIOCondition condition,
+                                       gpointer user_data) {
+  return loopback_flush(user_data, LOOPBACK_TUNNEL);
+}
+
+static gboolean loopback_remote_output(gint fd, GIOCondition condition,
+                                       gpointer user_data) {
+  return loopback_flush(user_data, LOOPBACK_REMOTE);
+}
+
+// Queues the record if the socket is full, keeping the order
+static gboolean loopback_send(TransportLoopbackLink *self, int end,
+                              const LoopbackMsgHeader *header,
+                              const void *data) {
+  const int fd = self->fd[end];
+  LoopbackOut *out;
+
+  if (fd < 0)
+    return FALSE;
+
+  if (g_queue_is_empty(self->out + end)) {
+    if (loopback_sendmsg(fd, header, data) >= 0)
+      return TRUE;
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      GERR("loopback send failed: %s", g_strerror(errno));
+      return FALSE;
+    }
+  }
+
+  out = g_malloc(sizeof(*out) + header->size);
+  out->header = *header;
+  if (header->size)
+    memcpy(out->data, data, header->size);
+  g_queue_push_tail(self->out + end, out);
+
+  if (!self->out_id[end])
+    self->out_id[end] = g_unix_fd_add(
+        fd, G_IO_OUT,
+        end == LOOPBACK_TUNNEL ? loopback_tunnel_output
+                               : loopback_remote_output,
+        self);
+  return TRUE;
+}
+
+// Closes one end of the socketpair, dropping what it had still to write
+static void loopback_close(TransportLoopbackLink *self, int end) {
+  if (self->watch_id[end]) {
+    g_source_remove(self->watch_id[end]);
+    self->watch_id[end] = 0;
+  }
+  if (self->out_id[end]) {
+    g_source_remove(self->out_id[end]);
+    self->out_id[end] = 0;
+  }
+  while (!g_queue_is_empty(self->out + end))
+    g_free(g_queue_pop_head(self->out + end));
+  if (self->fd[end] >= 0) {
+    close(self->fd[end]);
+    self->fd[end] = -1;
+  }
+}
+
+/* ==== emulated qcrilNrd ==== */
+
+static gboolean loopback_remote_indication(gpointer user_data) {
+  static const gint32 ids[] = {525323, 525322, 525320, 525340};
+  TransportLoopbackLink *self = user_data;
+  guint8 frame[OEM_HOOK_HEADER_SIZE + LOOPBACK_IND_SIZE];
+  const gint32 oem_hook_id = RIL_UNSOL_OEM_HOOK_RAW;
+  const gint32 resp_id = ids[self->ind_count++ % G_N_ELEMENTS(ids)];
+  const gint32 size = LOOPBACK_IND_SIZE;
+  LoopbackMsgHeader header = {.type = LOOPBACK_INDICATION,
+                              .size = sizeof(frame)};
+
+  memcpy(frame, &oem_hook_id, sizeof(gint32));
+  memcpy(frame + sizeof(gint32), OEM_STRING, OEM_STRING_LEN);
+  memcpy(frame + sizeof(gint32) + OEM_STRING_LEN, &resp_id, sizeof(gint32));
+  memcpy(frame + 2 * sizeof(gint32) + OEM_STRING_LEN, &size, sizeof(gint32));
+  memset(frame + OEM_HOOK_HEADER_SIZE, self->ind_count & 0xff,
+         LOOPBACK_IND_SIZE);
+
+  loopback_send(self, LOOPBACK_REMOTE, &header, frame);
+  return G_SOURCE_CONTINUE;
+}
+
+static void loopback_remote_answer(TransportLoopbackLink *self,
+                                   const LoopbackMsgHeader *request) {
+  TransportLoopback *transport = loopback_transport(self->parent.transport);
+  LoopbackMsgHeader reply = {.type = LOOPBACK_REPLY,
+                             .id = request->id,
+                             .status = TRANSPORT_STATUS_OK};
+
+  loopback_send(self, LOOPBACK_REMOTE, &reply, NULL);
+
+  if (request->type == LOOPBACK_SET_CALLBACK) {
+    self->callbacks_set = TRUE;
+    if (transport->ind_interval_ms && !self->ind_id)
+      self->ind_id = g_timeout_add(transport->ind_interval_ms,
+                                   loopback_remote_indication, self);
+  } else if (request->type == LOOPBACK_RAW_REQUEST && self->callbacks_set) {
+    LoopbackMsgHeader response = {.type = LOOPBACK_RESPONSE,
+                                  .serial = request->serial};
+
+    loopback_send(self, LOOPBACK_REMOTE, &response, NULL);
+  }
+}
+
+static gboolean loopback_remote_delayed_answer(gpointer user_data) {
+  LoopbackDelayed *delayed = user_data;
+  TransportLoopbackLink *self = delayed->link;
+
+  self->delayed = g_slist_remove(self->delayed, delayed);
+  loopback_remote_answer(self, &delayed->header);
+  g_free(delayed);
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean loopback_remote_input(gint fd, GIOCondition condition,
+                                      gpointer user_data) {
+  TransportLoopbackLink *self = user_data;
+  TransportLoopback *transport = loopback_transport(self->parent.transport);
+  LoopbackMsgHeader header;
+
+  if (condition & (G_IO_HUP | G_IO_ERR)) {
+    self->watch_id[LOOPBACK_REMOTE] = 0;
+    return G_SOURCE_REMOVE;
+  }
+
+  ssize_t len = recv(fd, self->buf, sizeof(header) + LOOPBACK_PAYLOAD_MAX, 0);
+  if (len < (ssize_t)sizeof(header))
+    return G_SOURCE_CONTINUE;
+
+  memcpy(&header, self->buf, sizeof(header));
+  if (transport->reply_delay_ms) {
+    LoopbackDelayed *delayed = g_new0(LoopbackDelayed, 1);
+
+    delayed->link = self;
+    delayed->header = header;
+    delayed->id = g_timeout_add(transport->reply_delay_ms,
+                                loopback_remote_delayed_answer, delayed);
+    self->delayed = g_slist_prepend(self->delayed, delayed);
+  } else {
+    loopback_remote_answer(self, &header);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+// Drops what the emulated remote still had to do
+static void loopback_remote_stop(TransportLoopbackLink *self) {
+  if (self->ind_id) {
+    g_source_remove(self->ind_id);
+    self->ind_id = 0;
+  }
+  for (GSList *l = self->delayed; l; l = l->next) {
+    LoopbackDelayed *delayed = l->data;
+
+    g_source_remove(delayed->id);
+    g_free(delayed);
+  }
+  g_slist_free(self->delayed);
+  self->delayed = NULL;
+}
+
+static gboolean loopback_appear(gpointer user_data);
+
+// The emulated qcrilNrd dies and registers again a moment later, like a
+// restarted service. The tunnel learns about it from the closed socket.
+static gboolean loopback_remote_die(gpointer user_data) {
+  TransportLoopbackLink *self = user_data;
+
+  self->die_id = 0;
+  GINFO("%s: emulated remote dies", self->parent.name);
+  loopback_remote_stop(self);
+  loopback_close(self, LOOPBACK_REMOTE);
+  self->registered = FALSE;
+  if (!self->appear_id)
+    self->appear_id =
+        g_timeout_add(LOOPBACK_RESTART_MS, loopback_appear, self);
+  return G_SOURCE_REMOVE;
+}
+
+/* ==== tunnel side ==== */
+
+static gboolean loopback_tunnel_input(gint fd, GIOCondition condition,
+                                      gpointer user_data) {
+  TransportLoopbackLink *self = user_data;
+  TransportLink *link = &self->parent;
+  LoopbackMsgHeader header;
+
+  if (condition & (G_IO_HUP | G_IO_ERR)) {
+    self->watch_id[LOOPBACK_TUNNEL] = 0;
+    link->handlers->died(link, link->user_data);
+    return G_SOURCE_REMOVE;
+  }
+
+  ssize_t len = recv(fd, self->buf, sizeof(header) + LOOPBACK_PAYLOAD_MAX, 0);
+  if (len < (ssize_t)sizeof(header))
+    return G_SOURCE_CONTINUE;
+
+  memcpy(&header, self->buf, sizeof(header));
+  if (header.size > len - sizeof(header)) {
+    GERR("loopback: truncated message");
+    return G_SOURCE_CONTINUE;
+  }
+
+  const guint8 *data = header.size ? self->buf + sizeof(header) : NULL;
+  switch (header.type) {
+  case LOOPBACK_REPLY: {
+    gpointer key = GUINT_TO_POINTER(header.id);
+    LoopbackTx *tx = g_hash_table_lookup(self->pending, key);
+
+    if (tx) {
+      g_hash_table_steal(self->pending, key);
+      if (tx->func)
+        tx->func(link, header.status, data, header.size, tx->user_data);
+      loopback_tx_free(tx);
+    }
+    break;
+  }
+  case LOOPBACK_RESPONSE:
+    link->handlers->response(link, header.serial, header.status, data,
+                             header.size, link->user_data);
+    break;
+  case LOOPBACK_INDICATION:
+    link->handlers->indication(link, data, header.size, link->user_data);
+    break;
+  default:
+    GWARN("loopback: unexpected message %u", header.type);
+    break;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static gulong loopback_transact(TransportLink *link, LoopbackMsgType type,
+                                gint32 serial, const void *data, gsize size,
+                                TransportReplyFunc func, gpointer user_data,
+                                GDestroyNotify destroy) {
+  TransportLoopback *transport = loopback_transport(link->transport);
+  TransportLoopbackLink *self = loopback_link(link);
+  LoopbackMsgHeader header = {.type = type, .serial = serial, .size = size};
+
+  if (size > LOOPBACK_PAYLOAD_MAX)
+    return 0;
+
+  header.id = ++transport->last_id;
+  if (!loopback_send(self, LOOPBACK_TUNNEL, &header, data))
+    return 0;
+
+  LoopbackTx *tx = g_new0(LoopbackTx, 1);
+  tx->func = func;
+  tx->user_data = user_data;
+  tx->destroy = destroy;
+  g_hash_table_insert(self->pending, GUINT_TO_POINTER(header.id), tx);
+  return header.id;
+}
+
+static gboolean loopback_appear(gpointer user_data) {
+  TransportLink *link = user_data;
+
+  loopback_link(link)->appear_id = 0;
+  loopback_link(link)->registered = TRUE;
+  link->handlers->appeared(link, link->user_data);
+  return G_SOURCE_REMOVE;
+}
+
+static TransportLink *transport_loopback_link_new(Transport *transport,
+                                                  const char *name) {
+  TransportLoopbackLink *self = g_new0(TransportLoopbackLink, 1);
+
+  self->fd[LOOPBACK_TUNNEL] = self->fd[LOOPBACK_REMOTE] = -1;
+  self->pending =
+      g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                            loopback_tx_free);
+  self->buf = g_malloc(sizeof(LoopbackMsgHeader) + LOOPBACK_PAYLOAD_MAX);
+  g_queue_init(self->out + LOOPBACK_TUNNEL);
+  g_queue_init(self->out + LOOPBACK_REMOTE);
+
+  // emulated service is registered right away
+  self->registered = TRUE;
+  self->appear_id = g_idle_add(loopback_appear, self);
+  return &self->parent;
+}
+
+// Closing the socketpair is the emulated remote going away
+static void transport_loopback_disconnect(TransportLink *link) {
+  TransportLoopbackLink *self = loopback_link(link);
+
+  if (self->connect_id) {
+    g_source_remove(self->connect_id);
+    self->connect_id = 0;
+  }
+  if (self->die_id) {
+    g_source_remove(self->die_id);
+    self->die_id = 0;
+  }
+  loopback_remote_stop(self);
+  loopback_close(self, LOOPBACK_TUNNEL);
+  loopback_close(self, LOOPBACK_REMOTE);
+
+  g_hash_table_remove_all(self->pending);
+  self->callbacks_set = FALSE;
+}
+
+static void transport_loopback_link_free(TransportLink *link) {
+  TransportLoopbackLink *self = loopback_link(link);
+
+  if (self->appear_id)
+    g_source_remove(self->appear_id);
+  transport_loopback_disconnect(link);
+  g_hash_table_destroy(self->pending);
+  g_free(self->buf);
+  g_free(self);
+}
+
+static gboolean loopback_connected(gpointer user_data) {
+  TransportLink *link = user_data;
+  TransportLoopback *transport = loopback_transport(link->transport);
+  TransportLoopbackLink *self = loopback_link(link);
+
+  self->connect_id = 0;
+  if (!self->registered) {
+    link->handlers->connected(link, FALSE, link->user_data);
+    return G_SOURCE_REMOVE;
+  }
+
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0,
+                 self->fd) < 0) {
+    GERR("loopback socketpair failed: %s", g_strerror(errno));
+    self->fd[LOOPBACK_TUNNEL] = self->fd[LOOPBACK_REMOTE] = -1;
+    link->handlers->connected(link, FALSE, link->user_data);
+    return G_SOURCE_REMOVE;
+  }
+
+  self->watch_id[LOOPBACK_TUNNEL] =
+      g_unix_fd_add(self->fd[LOOPBACK_TUNNEL], G_IO_IN | G_IO_HUP | G_IO_ERR,
+                    loopback_tunnel_input, self);
+  self->watch_id[LOOPBACK_REMOTE] =
+      g_unix_fd_add(self->fd[LOOPBACK_REMOTE], G_IO_IN | G_IO_HUP | G_IO_ERR,
+                    loopback_remote_input, self);
+  if (transport->lifetime_ms)
+    self->die_id =
+        g_timeout_add(transport->lifetime_ms, loopback_remote_die, self);
+
+  GINFO("Connected to %s (loopback)", link->name);
+  link->handlers->connected(link, TRUE, link->user_data);
+  return G_SOURCE_REMOVE;
+}
+
+// Completes from the main loop like a binder service lookup
+static gboolean transport_loopback_connect(TransportLink *link) {
+  TransportLoopbackLink *self = loopback_link(link);
+
+  transport_loopback_disconnect(link);
+  self->connect_id = g_idle_add(loopback_connected, self);
+  return TRUE;
+}
+
+static gulong transport_loopback_set_callback(TransportLink *link,
+                                              TransportReplyFunc func,
+                                              gpointer user_data,
+                                              GDestroyNotify destroy) {
+  return loopback_transact(link, LOOPBACK_SET_CALLBACK, 0, NULL, 0, func,
+                           user_data, destroy);
+}
+
+static gulong transport_loopback_raw_request(TransportLink *link,
+                                             gint32 serial, const void *data,
+                                             gsize size,
+                                             TransportReplyFunc func,
+                                             gpointer user_data,
+                                             GDestroyNotify destroy) {
+  return loopback_transact(link, LOOPBACK_RAW_REQUEST, serial, data, size,
+                           func, user_data, destroy);
+}
+
+static void transport_loopback_cancel(TransportLink *link, gulong id) {
+  g_hash_table_remove(loopback_link(link)->pending, GUINT_TO_POINTER(id));
+}
+
+static void transport_loopback_free(Transport *transport) {
+  g_free(loopback_transport(transport));
+}
+
+static const TransportOps transport_loopback_ops = {
+    .name = "loopback",
+    .free = transport_loopback_free,
+    .link_new = transport_loopback_link_new,
+    .link_free = transport_loopback_link_free,
+    .connect = transport_loopback_connect,
+    .disconnect = transport_loopback_disconnect,
+    .set_callback = transport_loopback_set_callback,
+    .raw_request = transport_loopback_raw_request,
+    .cancel = transport_loopback_cancel,
+};
+
+Transport *transport_loopback_new(guint reply_delay_ms, guint ind_interval_ms,
+                                  guint lifetime_ms) {
+  TransportLoopback *self = g_new0(TransportLoopback, 1);
+
+  self->parent.ops = &transport_loopback_ops;
+  self->reply_delay_ms = reply_delay_ms;
+  self->ind_interval_ms = ind_interval_ms;
+  self->lifetime_ms = lifetime_ms;
+  return &self->parent;
+}
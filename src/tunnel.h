@@ -9,72 +9,140 @@
  #ifndef TUNNEL_DEFINED
 #define TUNNEL_DEFINED
 
-#include <gbinder.h>
-
+#include "capture.h"
+#include "coalesce.h"
+#include "dispatch.h"
+#include "dumplimit.h"
+#include "indication.h"
+#include "notifier.h"
+#include "oemhook.h"
+#include "recorder.h"
+#include "request.h"
+#include "retry.h"
+#include "service.h"
 #include "sim_monitor.h"
-
-#define RADIO_ALIGNED(x) __attribute__((aligned(x)))
+#include "timeline.h"
+#include "transport.h"
+#include "warmstate.h"
 
 #define DEVICE_DEFAULT "/dev/hwbinder"
 #define QCRILHOOK_NAME_BASE "oemhook"
 #define QCRILHOOK_IFACE_DEFAULT                                                \
   "vendor.qti.hardware.radio.qcrilhook@1.0::IQtiOemHook"
 
-#define TRANSACTION_setCallback 1
-#define TRANSACTION_OEMHOOK_RAW_REQUEST 2
-
-#define QCOM_HOOK_RESPONSE_RAW 1
-#define QCOM_HOOK_INDICATION_RAW 1
-
-#define OEM_CHARS {'Q', 'O', 'E', 'M', 'H', 'O', 'O', 'K'}
-#define OEM_STRING "QOEMHOOK"
-#define OEM_STRING_ALT "SOMCHOOK"
-
-#define QCRIL_EVT_HOOK_SET_ATEL_UI_STATUS 524314
+#ifdef HAVE_GBINDER
+#define TRANSPORT_DEFAULT "gbinder"
+#else
+#define TRANSPORT_DEFAULT "loopback"
+#endif
 
 #define RET_OK (0)
 #define RET_NOTFOUND (1)
 #define RET_INVARG (2)
 #define RET_ERR (3)
 
-typedef struct app_config {
+// Shared by all slots
+typedef struct tunnel_config {
+  char *transport;
   char *device;
   char *interface;
-  char *name;
-  char *fqname;
   char *resp_iface;
   char *ind_iface;
+  char *stats_file; /* timeline export, NULL if none */
+  char *capture_file; /* traffic capture, NULL if none */
+  char *state_file;   /* warm-start state, NULL if none */
+} TunnelConfig;
+
+// Per slot
+typedef struct app_config {
+  char *name;
+  char *fqname;
   int sim;
 } AppConfig;
 
-typedef struct app {
+typedef struct tunnel Tunnel;
+typedef struct app App;
+
+// Connection to the remote instance
+typedef enum app_state {
+  APP_STATE_WAITING,    /* no remote, waiting for its registration */
+  APP_STATE_CONNECTING, /* service lookup in flight */
+  APP_STATE_CONNECTED,  /* remote known, callbacks not registered */
+  APP_STATE_READY       /* setCallback succeeded */
+} AppState;
+
+/* Completion of an asynchronous transaction to the remote */
+typedef void (*AppTransactFunc)(App *app, gboolean ok);
+
+// Connection to one oemhook instance
+struct app {
+  Tunnel *tunnel;
+  TransportLink *link;
+  AppState state;
+  gint64 died_at; /* last death of the remote, 0 once reconnected */
+  gboolean atel_ready_done; /* ATEL ready completed with this remote */
+  gboolean warm_unlocked;   /* unlocked in the previous run */
+  gulong set_callback_tx;    /* in-flight setCallback, 0 if none */
+  gint32 atel_ready_serial;  /* in-flight ATEL ready, 0 if none */
+  OemHookRequests requests;  /* raw requests awaiting their response */
+  Retry connect_retry;
+  Retry set_callback_retry;
+  Retry atel_ready_retry;
+  Coalescer atel_ready_coalescer; /* ATEL ready triggers */
+  guint instance;                 /* remotes connected so far */
+  guint unlock_epoch;             /* SIM unlocks so far */
+  guint64 atel_ready_key;         /* of the last ATEL ready sent */
+  gboolean atel_ready_again;      /* flushed while one was in flight */
+  AppTimeline timeline;
+  AppConfig config;
+};
+
+// Daemon serving all slots over one service manager, bus connection and
+// main loop
+struct tunnel {
   GMainLoop *loop;
-  GBinderServiceManager *sm;
-  GBinderLocalObject *local;
-  GBinderRemoteObject *remote;
-  gulong wait_id;
-  gulong death_id;
-  GBinderClient *client;
-  GBinderLocalObject *resp;
-  GBinderLocalObject *ind;
+  Transport *transport;
   SimMonitor *sim_monitor;
-  gboolean hidl_connected;
-  gboolean callbacks_set;
-  AppConfig config;
+  TunnelService *service;
+  OemHookDispatch dispatch; /* indication handlers, shared by all slots */
+  DumpLimiter dump;
+  Recorder recorder; /* last messages of all slots */
+  CaptureWriter *capture;
+  Notifier *notifier; /* NULL if not started by systemd */
+  WarmState *state;   /* NULL if not kept */
+  TunnelConfig config;
+  App *slots;
+  guint n_slots;
   int ret;
-} App;
+};
 
-typedef struct {
-  char oem[8] RADIO_ALIGNED(8); /* "QOEMHOOK" (no NUL) */
-  gint32 requestId
-      RADIO_ALIGNED(4); /* QCRIL_EVT_HOOK_SET_ATEL_UI_STATUS (524314) */
-  gint32 payloadLen RADIO_ALIGNED(4); /* length of following payload */
-  gint8 isReady RADIO_ALIGNED(1);     /* 1 = ready, 0 = not ready */
-} RADIO_ALIGNED(4) AtelReadyPayload;
+static inline gboolean app_connected(const App *app) {
+  return app->state >= APP_STATE_CONNECTED;
+}
+
+static inline gboolean app_ready(const App *app) {
+  return app->state == APP_STATE_READY;
+}
 
 ////
-extern int app_set_callback(App *app);
+// Both calls only submit the transaction and return FALSE if that was not
+// possible. The outcome is reported to `done` from the main loop, for ATEL
+// ready once its QCOM_HOOK_RESPONSE_RAW has arrived.
+extern gboolean app_set_callback(App *app, AppTransactFunc done);
+
+extern int send_atel_ready(App *app, AppTransactFunc done);
+
+// Raw request through the slot's request table, see
+// oem_hook_requests_submit()
+extern gint32 app_submit_request(App *app, const void *data, gsize size,
+                                 OemHookResponseFunc func, gpointer user_data,
+                                 GDestroyNotify destroy);
+
+extern void app_cancel_transactions(App *app);
+
+extern void app_handle_response(App *app, gint32 serial, gint32 err,
+                                const void *data, gsize size);
 
-extern int send_atel_ready(App *app);
+extern void app_handle_indication(App *app, const void *data, gsize size);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,113 @@
+/*
+ * Warm-start state kept across restarts within one boot
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "warmstate.h"
+
+#include <gutil_log.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WARM_STATE_SIZE                                                        \
+  (sizeof(WarmStateHeader) + WARM_STATE_MAX_SLOTS * sizeof(WarmSlot))
+#define BOOT_ID_FILE "/proc/sys/kernel/random/boot_id"
+
+G_STATIC_ASSERT(sizeof(WarmStateHeader) % 8 == 0);
+G_STATIC_ASSERT(sizeof(WarmSlot) % 8 == 0);
+
+struct warm_state {
+  int fd;
+  guint8 *map;
+};
+
+// Empty if unknown, then the file is only versioned
+static void warm_state_boot_id(char *boot_id) {
+  gchar *contents = NULL;
+
+  memset(boot_id, 0, WARM_STATE_BOOT_ID_MAX);
+  if (g_file_get_contents(BOOT_ID_FILE, &contents, NULL, NULL))
+    g_strlcpy(boot_id, g_strstrip(contents), WARM_STATE_BOOT_ID_MAX);
+  g_free(contents);
+}
+
+WarmState *warm_state_open(const char *path) {
+  char boot_id[WARM_STATE_BOOT_ID_MAX];
+  WarmStateHeader *header;
+  WarmState *state;
+  struct stat st;
+  int fd;
+
+  fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    GERR("Failed to open %s: %s", path, strerror(errno));
+    return NULL;
+  }
+
+  if (fstat(fd, &st) < 0 ||
+      ((gsize)st.st_size != WARM_STATE_SIZE &&
+       ftruncate(fd, WARM_STATE_SIZE) < 0)) {
+    GERR("Failed to size %s: %s", path, strerror(errno));
+    close(fd);
+    return NULL;
+  }
+
+  state = g_new0(WarmState, 1);
+  state->fd = fd;
+  state->map = mmap(NULL, WARM_STATE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd, 0);
+  if (state->map == MAP_FAILED) {
+    GERR("Failed to map %s: %s", path, strerror(errno));
+    close(fd);
+    g_free(state);
+    return NULL;
+  }
+
+  header = (WarmStateHeader *)state->map;
+  warm_state_boot_id(boot_id);
+  if (memcmp(header->magic, WARM_STATE_MAGIC, sizeof(header->magic)) ||
+      header->version != WARM_STATE_VERSION ||
+      header->size != WARM_STATE_SIZE ||
+      memcmp(header->boot_id, boot_id, sizeof(boot_id))) {
+    GINFO("Starting with empty state in %s", path);
+    memset(state->map, 0, WARM_STATE_SIZE);
+    memcpy(header->magic, WARM_STATE_MAGIC, sizeof(header->magic));
+    header->version = WARM_STATE_VERSION;
+    header->size = WARM_STATE_SIZE;
+    memcpy(header->boot_id, boot_id, sizeof(boot_id));
+  } else {
+    GINFO("Reusing state from %s", path);
+  }
+  return state;
+}
+
+void warm_state_close(WarmState *state) {
+  if (!state)
+    return;
+
+  munmap(state->map, WARM_STATE_SIZE);
+  close(state->fd);
+  g_free(state);
+}
+
+WarmSlot *warm_state_slot(WarmState *state, guint sim) {
+  if (!state || sim >= WARM_STATE_MAX_SLOTS)
+    return NULL;
+
+  return (WarmSlot *)(state->map + sizeof(WarmStateHeader)) + sim;
+}
+
+void warm_slot_update(WarmSlot *slot, const char *modem_path,
+                      gboolean unlocked, gboolean atel_ready) {
+  if (modem_path && strlen(modem_path) < sizeof(slot->modem_path))
+    g_strlcpy(slot->modem_path, modem_path, sizeof(slot->modem_path));
+  slot->unlocked = unlocked;
+  slot->atel_ready = atel_ready;
+  slot->updated = g_get_real_time();
+}
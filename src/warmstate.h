@@ -0,0 +1,72 @@
+/*
+ * Warm-start state kept across restarts within one boot
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef WARMSTATE_H
+#define WARMSTATE_H
+
+#include <glib.h>
+
+/*
+ * File layout, host byte order: WarmStateHeader followed by
+ * WARM_STATE_MAX_SLOTS WarmSlot records, one per SIM index. The file is
+ * memory mapped and updated in place. A file from another boot, with
+ * another version or size is reset.
+ */
+#define WARM_STATE_MAGIC "QHOOKWSS"
+#define WARM_STATE_VERSION 1
+#define WARM_STATE_MAX_SLOTS 4
+#define WARM_STATE_PATH_MAX 64
+#define WARM_STATE_BOOT_ID_MAX 40
+
+typedef struct warm_state_header {
+  char magic[8];
+  guint32 version;
+  guint32 size; /* of the whole file */
+  char boot_id[WARM_STATE_BOOT_ID_MAX];
+} WarmStateHeader;
+
+typedef struct warm_slot {
+  char modem_path[WARM_STATE_PATH_MAX]; /* empty if not resolved */
+  guint8 unlocked;                      /* per oFono */
+  guint8 atel_ready;                    /* acknowledged by qcrilNrd */
+  guint16 reserved;
+  guint32 reserved2;
+  gint64 updated; /* wall clock time, us since the epoch */
+} WarmSlot;
+
+typedef struct warm_state WarmState;
+
+/**
+ * Open state file, creating or resetting it if needed
+ * @param path: File name
+ * @return: State or NULL on failure
+ */
+WarmState *warm_state_open(const char *path);
+
+/**
+ * Unmap and close state file
+ * @param state: State (can be NULL)
+ */
+void warm_state_close(WarmState *state);
+
+/**
+ * @param state: State (can be NULL)
+ * @param sim: SIM index
+ * @return: Record of the slot, NULL if there is none
+ */
+WarmSlot *warm_state_slot(WarmState *state, guint sim);
+
+/**
+ * Update the record of the slot
+ * @param slot: Record
+ * @param modem_path: Resolved modem path, NULL keeps the stored one
+ * @param unlocked: SIM unlocked
+ * @param atel_ready: ATEL ready acknowledged with the current remote
+ */
+void warm_slot_update(WarmSlot *slot, const char *modem_path,
+                      gboolean unlocked, gboolean atel_ready);
+
+#endif
@@ -0,0 +1,452 @@
+/*
+ * Microbenchmarks for the tunnel hot paths
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "capture.h"
+#include "dispatch.h"
+#include "dumplimit.h"
+#include "indication.h"
+#include "oemhook.h"
+#include "recorder.h"
+#include "request.h"
+
+#include <gutil_log.h>
+
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_ITERATIONS_DEFAULT 1000000
+#define BENCH_ADN_RECORDS_SIZE 4096
+#define BENCH_ADN_RECORDS_COUNT 250
+#define BENCH_REQUESTS_IN_FLIGHT 16
+
+/*
+ * Allocation counting. Interposing malloc family catches allocations done
+ * by GLib as well. Only available with glibc, elsewhere 0 is reported.
+ */
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static guint64 bench_allocs = 0;
+
+void *malloc(size_t size) {
+  bench_allocs++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+  bench_allocs++;
+  return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  bench_allocs++;
+  return __libc_realloc(ptr, size);
+}
+#else
+static const guint64 bench_allocs = 0;
+#endif
+
+typedef struct bench_frame {
+  const char *name;
+  guint8 *data;
+  gsize size;
+} BenchFrame;
+
+typedef void (*BenchFunc)(gpointer data);
+
+static gint opt_iterations = BENCH_ITERATIONS_DEFAULT;
+static gchar **opt_frames = NULL;
+static gchar **opt_captures = NULL;
+
+static GOptionEntry option_entries[] = {
+    {"iterations", 'n', 0, G_OPTION_ARG_INT, &opt_iterations,
+     "Iterations per benchmark (default: 1000000)", "N"},
+    {"frames", 'f', 0, G_OPTION_ARG_FILENAME_ARRAY, &opt_frames,
+     "Recorded frames, one hex encoded frame per line", "FILE"},
+    {"capture", 'c', 0, G_OPTION_ARG_FILENAME_ARRAY, &opt_captures,
+     "Capture file written by the daemon with --capture", "FILE"},
+    {NULL}};
+
+static volatile guint64 bench_sink;
+
+static gint64 bench_now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void bench_run(const char *name, BenchFunc fn, gpointer data) {
+  const guint64 n = opt_iterations;
+
+  // warm up caches and branch predictors
+  for (guint64 i = 0; i < n / 100; i++)
+    fn(data);
+
+  const guint64 allocs = bench_allocs;
+  const gint64 start = bench_now_ns();
+  for (guint64 i = 0; i < n; i++)
+    fn(data);
+  const gint64 elapsed = bench_now_ns() - start;
+
+  printf("%-40s %10.2f ns/op %8.3f allocs/op\n", name, (double)elapsed / n,
+         (double)(bench_allocs - allocs) / n);
+}
+
+static BenchFrame *bench_frame_new(const char *name, gint32 oem_hook_id,
+                                   const char *magic, gint32 resp_id,
+                                   gsize payload_size, gsize offset) {
+  BenchFrame *frame = g_new0(BenchFrame, 1);
+  const gint32 size = payload_size;
+  guint8 *ptr;
+
+  // offset allows unaligned frames, the buffer is never freed
+  frame->name = name;
+  frame->size = OEM_HOOK_HEADER_SIZE + payload_size;
+  ptr = (guint8 *)g_malloc0(frame->size + offset) + offset;
+  frame->data = ptr;
+  memcpy(ptr, &oem_hook_id, sizeof(oem_hook_id));
+  memcpy(ptr + sizeof(gint32), magic, OEM_STRING_LEN);
+  memcpy(ptr + sizeof(gint32) + OEM_STRING_LEN, &resp_id, sizeof(resp_id));
+  memcpy(ptr + 2 * sizeof(gint32) + OEM_STRING_LEN, &size, sizeof(size));
+  for (gsize i = 0; i < payload_size; i++)
+    ptr[OEM_HOOK_HEADER_SIZE + i] = (guint8)i;
+
+  return frame;
+}
+
+// Reads frames written as hex, one per line. '#' starts a comment.
+static GPtrArray *bench_load_frames(const char *path) {
+  GPtrArray *frames = g_ptr_array_new();
+  GError *error = NULL;
+  gchar *contents = NULL;
+
+  if (!g_file_get_contents(path, &contents, NULL, &error)) {
+    GERR("%s", error->message);
+    g_error_free(error);
+    return frames;
+  }
+
+  gchar **lines = g_strsplit(contents, "\n", -1);
+  for (guint i = 0; lines[i]; i++) {
+    GString *bytes = g_string_new(NULL);
+    gint hi = -1;
+
+    for (const gchar *p = lines[i]; *p && *p != '#'; p++) {
+      const gint digit = g_ascii_xdigit_value(*p);
+
+      if (digit < 0)
+        continue;
+      if (hi < 0) {
+        hi = digit;
+      } else {
+        g_string_append_c(bytes, (gchar)((hi << 4) | digit));
+        hi = -1;
+      }
+    }
+
+    if (bytes->len) {
+      BenchFrame *frame = g_new0(BenchFrame, 1);
+
+      frame->name = g_strdup_printf("%s:%u", path, i + 1);
+      frame->size = bytes->len;
+      frame->data = (guint8 *)g_string_free(bytes, FALSE);
+      g_ptr_array_add(frames, frame);
+    } else {
+      g_string_free(bytes, TRUE);
+    }
+  }
+
+  g_strfreev(lines);
+  g_free(contents);
+  return frames;
+}
+
+// First indication of each resp_id in the capture
+static GPtrArray *bench_load_capture(const char *path) {
+  GPtrArray *frames = g_ptr_array_new();
+  CaptureReader *reader = capture_reader_new(path);
+  GHashTable *seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+  gchar *base = g_path_get_basename(path);
+  CaptureRecord rec;
+
+  while (reader && capture_reader_next(reader, &rec)) {
+    OemHookFrame parsed;
+    gint32 resp_id = 0;
+
+    if (rec.kind != CAPTURE_INDICATION)
+      continue;
+    if (parse_oem_hook_message(rec.data, rec.size, &parsed))
+      resp_id = parsed.resp_id;
+    if (g_hash_table_contains(seen, GINT_TO_POINTER(resp_id)))
+      continue;
+
+    BenchFrame *frame = g_new0(BenchFrame, 1);
+    g_hash_table_add(seen, GINT_TO_POINTER(resp_id));
+    frame->name = g_strdup_printf("%s/%d %s", base, resp_id,
+                                  oem_hook_ind_name(resp_id));
+    frame->data = g_malloc(rec.size);
+    frame->size = rec.size;
+    memcpy(frame->data, rec.data, rec.size);
+    g_ptr_array_add(frames, frame);
+  }
+
+  g_free(base);
+  g_hash_table_destroy(seen);
+  capture_reader_free(reader);
+  return frames;
+}
+
+static void bench_parse(gpointer data) {
+  const BenchFrame *frame = data;
+  OemHookFrame parsed;
+
+  bench_sink += parse_oem_hook_message(frame->data, frame->size, &parsed);
+  bench_sink += parsed.size;
+}
+
+static void bench_handler(gint32 resp_id, const void *data, gsize size,
+                          gpointer context, gpointer user_data) {
+  bench_sink += size;
+}
+
+typedef struct bench_dispatch {
+  OemHookDispatch dispatch;
+  gint32 resp_id;
+} BenchDispatch;
+
+static void bench_dispatch(gpointer data) {
+  BenchDispatch *bench = data;
+
+  bench_sink += oem_hook_dispatch(&bench->dispatch, bench->resp_id, NULL, 0,
+                                  NULL);
+}
+
+// Payload dump decision, made for every response
+static void bench_response(gpointer data) {
+  DumpLimiter *limiter = data;
+  guint suppressed = 0;
+
+  bench_sink += dump_limiter_take_response(limiter, bench_now_ns() / 1000,
+                                           &suppressed);
+}
+
+/*
+ * Transport that accepts every request and never answers. Responses are
+ * fed to oem_hook_requests_complete() directly, as the daemon does.
+ */
+static gulong bench_raw_request(TransportLink *link, gint32 serial,
+                                const void *data, gsize size,
+                                TransportReplyFunc func, gpointer user_data,
+                                GDestroyNotify destroy) {
+  return serial;
+}
+
+static void bench_cancel(TransportLink *link, gulong id) {}
+
+static const TransportOps bench_transport_ops = {
+    .name = "bench",
+    .raw_request = bench_raw_request,
+    .cancel = bench_cancel,
+};
+
+typedef struct bench_requests {
+  Transport transport;
+  TransportLink link;
+  OemHookRequests requests;
+  gint32 serials[BENCH_REQUESTS_IN_FLIGHT];
+  guint next;
+} BenchRequests;
+
+static void bench_request_done(int status, gint32 err, const void *data,
+                               gsize size, gpointer user_data) {
+  bench_sink += size;
+}
+
+static gint32 bench_request_submit(BenchRequests *bench) {
+  static const guint8 request[16];
+
+  return oem_hook_requests_submit(&bench->requests, request, sizeof(request),
+                                  0, bench_request_done, NULL, NULL);
+}
+
+static BenchRequests *bench_requests_new(void) {
+  BenchRequests *bench = g_new0(BenchRequests, 1);
+
+  bench->transport.ops = &bench_transport_ops;
+  bench->link.transport = &bench->transport;
+  oem_hook_requests_init(&bench->requests, &bench->link);
+  for (guint i = 0; i < BENCH_REQUESTS_IN_FLIGHT; i++)
+    bench->serials[i] = bench_request_submit(bench);
+  return bench;
+}
+
+static void bench_requests_free(BenchRequests *bench) {
+  oem_hook_requests_cleanup(&bench->requests);
+  g_free(bench);
+}
+
+// QCOM_HOOK_RESPONSE_RAW for the oldest request in flight: serial lookup
+// and completion. A new request takes its place, so that the table keeps
+// its size.
+static void bench_response_complete(gpointer data) {
+  static const guint8 response[16];
+  BenchRequests *bench = data;
+  const guint i = bench->next++ % BENCH_REQUESTS_IN_FLIGHT;
+
+  bench_sink += oem_hook_requests_complete(&bench->requests, bench->serials[i],
+                                           0, response, sizeof(response));
+  bench->serials[i] = bench_request_submit(bench);
+}
+
+static void bench_recorder(gpointer data) {
+  const BenchFrame *frame = data;
+  static Recorder recorder;
+
+  recorder_add(&recorder, RECORD_INDICATION, 0, 0, 525323, 0, frame->data,
+               frame->size, 0);
+  bench_sink += recorder.count;
+}
+
+static void bench_put16(GByteArray *buf, guint16 value) {
+  g_byte_array_append(buf, (const guint8 *)&value, sizeof(value));
+}
+
+static void bench_put_string(GByteArray *buf, const char *str) {
+  const gsize len = strlen(str);
+
+  bench_put16(buf, len);
+  g_byte_array_append(buf, (const guint8 *)str, len);
+}
+
+// AdnRecordsInd payload, not a frame. The buffer is never freed.
+static OemHookBytes *bench_adn_records_new(guint count) {
+  OemHookBytes *bytes = g_new0(OemHookBytes, 1);
+  GByteArray *buf = g_byte_array_new();
+
+  bench_put16(buf, count);
+  for (guint i = 0; i < count; i++) {
+    bench_put16(buf, i + 1);
+    bench_put_string(buf, "Contact");
+    bench_put_string(buf, "+358401234567");
+    bench_put16(buf, 1);
+    bench_put_string(buf, "contact@example.org");
+    bench_put16(buf, 0);
+  }
+
+  bytes->size = buf->len;
+  bytes->data = g_byte_array_free(buf, FALSE);
+  return bytes;
+}
+
+static void bench_adn_records(gpointer data) {
+  const OemHookBytes *payload = data;
+  AdnRecordsIter iter;
+  AdnRecord record;
+
+  adn_records_iter_init(&iter, payload->data, payload->size);
+  while (adn_records_iter_next(&iter, &record))
+    bench_sink += record.number.size;
+}
+
+static void bench_atel_ready(gpointer data) {
+  AtelReadyPayload payload;
+
+  oem_hook_atel_ready_init(&payload, TRUE);
+  bench_sink += payload.isReady;
+}
+
+int main(int argc, char *argv[]) {
+  GError *error = NULL;
+  GOptionContext *context = g_option_context_new("- tunnel microbenchmarks");
+
+  g_option_context_add_main_entries(context, option_entries, NULL);
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("Option parsing failed: %s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return 1;
+  }
+  g_option_context_free(context);
+
+  if (opt_iterations <= 0) {
+    g_printerr("Invalid number of iterations: %d\n", opt_iterations);
+    return 1;
+  }
+
+  gutil_log_timestamp = FALSE;
+  gutil_log_set_type(GLOG_TYPE_STDERR, "tunnel-bench");
+
+  GPtrArray *frames = g_ptr_array_new();
+  g_ptr_array_add(frames, bench_frame_new("parse/small", RIL_UNSOL_OEM_HOOK_RAW,
+                                          OEM_STRING, 525322, 4, 0));
+  g_ptr_array_add(frames,
+                  bench_frame_new("parse/small-unaligned",
+                                  RIL_UNSOL_OEM_HOOK_RAW, OEM_STRING, 525322,
+                                  4, 1));
+  g_ptr_array_add(frames, bench_frame_new("parse/adn-records",
+                                          RIL_UNSOL_OEM_HOOK_RAW,
+                                          OEM_STRING_ALT, 525323,
+                                          BENCH_ADN_RECORDS_SIZE, 0));
+  g_ptr_array_add(frames, bench_frame_new("parse/bad-magic",
+                                          RIL_UNSOL_OEM_HOOK_RAW, "XXXXXXXX",
+                                          525323, 4, 0));
+  BenchFrame *truncated = bench_frame_new(
+      "parse/truncated", RIL_UNSOL_OEM_HOOK_RAW, OEM_STRING, 525323, 64, 0);
+  truncated->size -= 1;
+  g_ptr_array_add(frames, truncated);
+
+  for (guint i = 0; opt_frames && opt_frames[i]; i++) {
+    GPtrArray *loaded = bench_load_frames(opt_frames[i]);
+
+    for (guint k = 0; k < loaded->len; k++)
+      g_ptr_array_add(frames, loaded->pdata[k]);
+    g_ptr_array_free(loaded, TRUE);
+  }
+
+  for (guint i = 0; opt_captures && opt_captures[i]; i++) {
+    GPtrArray *loaded = bench_load_capture(opt_captures[i]);
+
+    for (guint k = 0; k < loaded->len; k++)
+      g_ptr_array_add(frames, loaded->pdata[k]);
+    g_ptr_array_free(loaded, TRUE);
+  }
+
+  for (guint i = 0; i < frames->len; i++) {
+    BenchFrame *frame = frames->pdata[i];
+
+    bench_run(frame->name, bench_parse, frame);
+  }
+
+  BenchDispatch dispatch;
+  oem_hook_dispatch_init(&dispatch.dispatch);
+  oem_hook_dispatch_register(&dispatch.dispatch, 525323, bench_handler, NULL);
+  dispatch.resp_id = 525323;
+  bench_run("dispatch/handled", bench_dispatch, &dispatch);
+  dispatch.resp_id = 525322;
+  bench_run("dispatch/unhandled", bench_dispatch, &dispatch);
+  dispatch.resp_id = 1;
+  bench_run("dispatch/out-of-range", bench_dispatch, &dispatch);
+
+  DumpLimiter *limiter = g_new0(DumpLimiter, 1);
+  bench_run("response/dump-limit", bench_response, limiter);
+  g_free(limiter);
+
+  BenchRequests *requests = bench_requests_new();
+  bench_run("response/complete", bench_response_complete, requests);
+  bench_requests_free(requests);
+
+  bench_run("atel-ready/build", bench_atel_ready, NULL);
+  bench_run("decode/adn-records", bench_adn_records,
+            bench_adn_records_new(BENCH_ADN_RECORDS_COUNT));
+  bench_run("recorder/add", bench_recorder, frames->pdata[2]);
+
+  g_strfreev(opt_frames);
+  g_strfreev(opt_captures);
+  return 0;
+}
@@ -0,0 +1,217 @@
+/*
+ * Replay of captured OEM hook traffic through the tunnel's parser and
+ * indication dispatch
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "capture.h"
+#include "dispatch.h"
+#include "indication.h"
+#include "oemhook.h"
+
+#include <gutil_log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct replay_stats {
+  gint32 resp_id;
+  guint64 count;
+  guint64 bytes;
+  gint64 ns;
+} ReplayStats;
+
+typedef struct replay {
+  OemHookDispatch dispatch;
+  GHashTable *stats; /* resp_id => ReplayStats */
+  guint64 frames;
+  guint64 bytes;
+  guint64 bad;
+  guint64 skipped; /* responses */
+  gint64 busy_ns;  /* spent in parse and dispatch */
+} Replay;
+
+static gint opt_repeat = 1;
+static gboolean opt_realtime = FALSE;
+static gdouble opt_speed = 1.0;
+
+static GOptionEntry option_entries[] = {
+    {"repeat", 'r', 0, G_OPTION_ARG_INT, &opt_repeat,
+     "Replay the capture N times (default: 1)", "N"},
+    {"realtime", 't', 0, G_OPTION_ARG_NONE, &opt_realtime,
+     "Keep the original timing instead of replaying at line rate", NULL},
+    {"speed", 's', 0, G_OPTION_ARG_DOUBLE, &opt_speed,
+     "Speed factor for --realtime (default: 1.0)", "X"},
+    {NULL}};
+
+static volatile guint64 replay_sink;
+
+static gint64 replay_now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static ReplayStats *replay_stats(Replay *replay, gint32 resp_id) {
+  ReplayStats *stats =
+      g_hash_table_lookup(replay->stats, GINT_TO_POINTER(resp_id));
+
+  if (!stats) {
+    stats = g_new0(ReplayStats, 1);
+    stats->resp_id = resp_id;
+    g_hash_table_insert(replay->stats, GINT_TO_POINTER(resp_id), stats);
+  }
+  return stats;
+}
+
+// Same steps as app_handle_indication() minus logging
+static void replay_indication(Replay *replay, const CaptureRecord *rec) {
+  const gint64 start = replay_now_ns();
+  OemHookFrame frame;
+  gint32 resp_id = 0;
+
+  if (parse_oem_hook_message(rec->data, rec->size, &frame)) {
+    resp_id = frame.resp_id;
+    if (frame.oem_hook_id == RIL_UNSOL_OEM_HOOK_RAW)
+      replay_sink += oem_hook_dispatch(&replay->dispatch, frame.resp_id,
+                                       frame.payload, frame.size, NULL);
+  } else {
+    replay->bad++;
+  }
+
+  const gint64 ns = replay_now_ns() - start;
+  ReplayStats *stats = replay_stats(replay, resp_id);
+
+  stats->count++;
+  stats->bytes += rec->size;
+  stats->ns += ns;
+  replay->frames++;
+  replay->bytes += rec->size;
+  replay->busy_ns += ns;
+}
+
+static void replay_capture(Replay *replay, CaptureReader *reader) {
+  const gint64 start = replay_now_ns();
+  CaptureRecord rec;
+  gint64 first = -1;
+
+  while (capture_reader_next(reader, &rec)) {
+    if (rec.kind != CAPTURE_INDICATION) {
+      replay->skipped++;
+      continue;
+    }
+
+    if (opt_realtime) {
+      if (first < 0)
+        first = rec.time;
+
+      const gint64 due =
+          start + (gint64)((rec.time - first) * 1000 / opt_speed);
+      const gint64 wait = due - replay_now_ns();
+
+      if (wait > 0)
+        g_usleep(wait / 1000);
+    }
+
+    replay_indication(replay, &rec);
+  }
+}
+
+static gint replay_stats_compare(gconstpointer a, gconstpointer b) {
+  const ReplayStats *x = *(const ReplayStats *const *)a;
+  const ReplayStats *y = *(const ReplayStats *const *)b;
+
+  return (y->ns > x->ns) - (y->ns < x->ns);
+}
+
+static void replay_report(Replay *replay, gint64 elapsed_ns) {
+  GPtrArray *sorted = g_ptr_array_new();
+  GHashTableIter it;
+  gpointer value;
+
+  printf("frames=%" G_GUINT64_FORMAT " bytes=%" G_GUINT64_FORMAT
+         " bad=%" G_GUINT64_FORMAT " skipped=%" G_GUINT64_FORMAT "\n",
+         replay->frames, replay->bytes, replay->bad, replay->skipped);
+  if (replay->frames) {
+    printf("elapsed=%.3f ms busy=%.3f ms rate=%.0f frames/s %.2f MB/s "
+           "%.1f ns/frame\n",
+           elapsed_ns / 1e6, replay->busy_ns / 1e6,
+           replay->frames * 1e9 / MAX(elapsed_ns, 1),
+           replay->bytes * 1e3 / MAX(elapsed_ns, 1),
+           (double)replay->busy_ns / replay->frames);
+  }
+
+  // most expensive first
+  g_hash_table_iter_init(&it, replay->stats);
+  while (g_hash_table_iter_next(&it, NULL, &value))
+    g_ptr_array_add(sorted, value);
+  g_ptr_array_sort(sorted, replay_stats_compare);
+
+  printf("%-10s %-20s %10s %12s %12s %10s\n", "resp_id", "name", "count",
+         "bytes", "total_us", "ns/frame");
+  for (guint i = 0; i < sorted->len; i++) {
+    const ReplayStats *stats = sorted->pdata[i];
+
+    printf("%-10d %-20s %10" G_GUINT64_FORMAT " %12" G_GUINT64_FORMAT
+           " %12.1f %10.1f\n",
+           stats->resp_id, oem_hook_ind_name(stats->resp_id), stats->count,
+           stats->bytes, stats->ns / 1e3, (double)stats->ns / stats->count);
+  }
+  g_ptr_array_free(sorted, TRUE);
+}
+
+int main(int argc, char *argv[]) {
+  GError *error = NULL;
+  GOptionContext *context =
+      g_option_context_new("CAPTURE... - replay captured indications");
+  Replay replay;
+  int ret = 0;
+
+  g_option_context_add_main_entries(context, option_entries, NULL);
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("Option parsing failed: %s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return 1;
+  }
+  g_option_context_free(context);
+
+  if (argc < 2 || opt_repeat <= 0 || opt_speed <= 0) {
+    g_printerr("Usage: %s [--repeat N] [--realtime [--speed X]] CAPTURE...\n",
+               argv[0]);
+    return 1;
+  }
+
+  gutil_log_timestamp = FALSE;
+  gutil_log_set_type(GLOG_TYPE_STDERR, "tunnel-replay");
+  // the decoders log every indication, that is not what is measured
+  gutil_log_default.level = GLOG_LEVEL_WARN;
+
+  memset(&replay, 0, sizeof(replay));
+  oem_hook_dispatch_init(&replay.dispatch);
+  oem_hook_register_decoders(&replay.dispatch);
+  replay.stats = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                       g_free);
+
+  const gint64 start = replay_now_ns();
+  for (int i = 1; i < argc; i++) {
+    CaptureReader *reader = capture_reader_new(argv[i]);
+
+    if (!reader) {
+      ret = 1;
+      continue;
+    }
+    for (int k = 0; k < opt_repeat; k++) {
+      capture_reader_rewind(reader);
+      replay_capture(&replay, reader);
+    }
+    capture_reader_free(reader);
+  }
+
+  replay_report(&replay, replay_now_ns() - start);
+  g_hash_table_destroy(replay.stats);
+  return ret;
+}
@@ -0,0 +1,636 @@
+/*
+ * Unlock to ATEL ready latency harness
+ *
+ * Runs a private dbus-daemon with a scripted oFono mock and the tunnel on
+ * the loopback transport, drives SIM unlock sequences and reports the time
+ * from the unlocking event to the ATEL ready completion.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define OFONO_SERVICE "org.ofono"
+#define OFONO_MANAGER_PATH "/"
+#define OFONO_MANAGER_IFACE "org.nemomobile.ofono.ModemManager"
+#define OFONO_SIM_MANAGER_IFACE "org.ofono.SimManager"
+#define MOCK_MODEM_PATH "/ril_0"
+
+#define WAIT_TIMEOUT_MS 10000
+
+static const char bus_config[] =
+    "<!DOCTYPE busconfig PUBLIC"
+    " \"-//freedesktop//DTD D-Bus Bus Configuration 1.0//EN\""
+    " \"http://www.freedesktop.org/standards/dbus/1.0/busconfig.dtd\">\n"
+    "<busconfig>\n"
+    "  <type>session</type>\n"
+    "  <listen>unix:dir=%s</listen>\n"
+    "  <auth>EXTERNAL</auth>\n"
+    "  <policy context=\"default\">\n"
+    "    <allow send_destination=\"*\" eavesdrop=\"true\"/>\n"
+    "    <allow eavesdrop=\"true\"/>\n"
+    "    <allow own=\"*\"/>\n"
+    "  </policy>\n"
+    "</busconfig>\n";
+
+static const char mock_xml[] =
+    "<node>"
+    "  <interface name='" OFONO_MANAGER_IFACE "'>"
+    "    <method name='GetAvailableModems'>"
+    "      <arg type='ao' direction='out'/>"
+    "    </method>"
+    "  </interface>"
+    "  <interface name='" OFONO_SIM_MANAGER_IFACE "'>"
+    "    <method name='GetProperties'>"
+    "      <arg type='a{sv}' direction='out'/>"
+    "    </method>"
+    "    <signal name='PropertyChanged'>"
+    "      <arg type='s'/>"
+    "      <arg type='v'/>"
+    "    </signal>"
+    "  </interface>"
+    "</node>";
+
+/* Daemon log lines the harness synchronizes on */
+typedef enum harness_event {
+  EVENT_MONITORING,
+  EVENT_CALLBACKS,
+  EVENT_ATEL_READY,
+  EVENT_OFONO_GONE,
+  EVENT_COUNT
+} HarnessEvent;
+
+static const char *const harness_event_text[EVENT_COUNT] = {
+    [EVENT_MONITORING] = "Started monitoring SIM",
+    [EVENT_CALLBACKS] = "setCallback succeeded",
+    [EVENT_ATEL_READY] = "ATEL ready sent successfully",
+    [EVENT_OFONO_GONE] = "oFono became unavailable",
+};
+
+typedef struct harness {
+  GMainLoop *loop;
+  char *tmpdir;
+  char *config;
+  GSubprocess *bus;
+  char *address;
+  GDBusConnection *conn;
+  GDBusNodeInfo *node;
+  guint manager_reg;
+  guint sim_reg;
+  guint owner_id;
+  gboolean name_owned;
+  gint64 name_owned_time;
+  GHashTable *props; /* name => GVariant */
+  GSubprocess *daemon;
+  GDataInputStream *daemon_err;
+  GCancellable *daemon_cancel;
+  gboolean daemon_exited;
+  guint event_count[EVENT_COUNT];
+  gint64 event_time[EVENT_COUNT];
+  HarnessEvent wait_event;
+  guint wait_count;
+  guint timeout_id; /* of the pending wait, 0 once it has expired */
+} Harness;
+
+typedef gint64 (*HarnessScenarioFunc)(Harness *h);
+
+typedef struct harness_scenario {
+  const char *name;
+  HarnessScenarioFunc run;
+} HarnessScenario;
+
+static char *opt_daemon = "./fake-qcrilmsgtunnel";
+static char *opt_dbus_daemon = "dbus-daemon";
+static char *opt_scenario = NULL;
+static gint opt_runs = 20;
+static gint opt_delay = 0;
+static gboolean opt_verbose = FALSE;
+
+static GOptionEntry option_entries[] = {
+    {"daemon", 'd', 0, G_OPTION_ARG_FILENAME, &opt_daemon,
+     "Tunnel executable (default: ./fake-qcrilmsgtunnel)", "PATH"},
+    {"dbus-daemon", 0, 0, G_OPTION_ARG_FILENAME, &opt_dbus_daemon,
+     "dbus-daemon executable (default: dbus-daemon)", "PATH"},
+    {"scenario", 's', 0, G_OPTION_ARG_STRING, &opt_scenario,
+     "Run only this scenario: unlock, burst, late-ofono or ofono-restart",
+     "NAME"},
+    {"runs", 'n', 0, G_OPTION_ARG_INT, &opt_runs,
+     "Runs per scenario (default: 20)", "N"},
+    {"loopback-delay", 0, 0, G_OPTION_ARG_INT, &opt_delay,
+     "Reply delay of the emulated qcrilNrd", "MS"},
+    {"verbose", 'v', 0, G_OPTION_ARG_NONE, &opt_verbose,
+     "Echo tunnel log", NULL},
+    {NULL}};
+
+/* ==== waiting ==== */
+
+static gboolean harness_timeout(gpointer user_data) {
+  Harness *h = user_data;
+
+  h->timeout_id = 0;
+  g_main_loop_quit(h->loop);
+  return G_SOURCE_REMOVE;
+}
+
+// Every wait is bounded by WAIT_TIMEOUT_MS
+static void harness_arm(Harness *h) {
+  h->timeout_id = g_timeout_add(WAIT_TIMEOUT_MS, harness_timeout, h);
+}
+
+static void harness_disarm(Harness *h) {
+  if (h->timeout_id) {
+    g_source_remove(h->timeout_id);
+    h->timeout_id = 0;
+  }
+}
+
+/* ==== oFono mock ==== */
+
+static void mock_method_call(GDBusConnection *conn, const gchar *sender,
+                             const gchar *path, const gchar *iface,
+                             const gchar *method, GVariant *params,
+                             GDBusMethodInvocation *call, gpointer user_data) {
+  Harness *h = user_data;
+
+  if (!g_strcmp0(method, "GetAvailableModems")) {
+    const gchar *modems[] = {MOCK_MODEM_PATH, NULL};
+
+    g_dbus_method_invocation_return_value(call,
+                                          g_variant_new("(^ao)", modems));
+  } else if (!g_strcmp0(method, "GetProperties")) {
+    GVariantBuilder builder;
+    GHashTableIter it;
+    gpointer key, value;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+    g_hash_table_iter_init(&it, h->props);
+    while (g_hash_table_iter_next(&it, &key, &value))
+      g_variant_builder_add(&builder, "{sv}", key, value);
+    g_dbus_method_invocation_return_value(
+        call, g_variant_new("(a{sv})", &builder));
+  } else {
+    g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
+                                          G_DBUS_ERROR_UNKNOWN_METHOD,
+                                          "Unknown method %s", method);
+  }
+}
+
+static const GDBusInterfaceVTable mock_vtable = {mock_method_call, NULL,
+                                                 NULL};
+
+static void mock_set(Harness *h, const char *name, GVariant *value,
+                     gboolean emit) {
+  g_variant_ref_sink(value);
+  if (emit)
+    g_dbus_connection_emit_signal(h->conn, NULL, MOCK_MODEM_PATH,
+                                  OFONO_SIM_MANAGER_IFACE, "PropertyChanged",
+                                  g_variant_new("(sv)", name, value), NULL);
+  g_hash_table_replace(h->props, g_strdup(name), value);
+}
+
+static void mock_sim_absent(Harness *h) {
+  g_hash_table_remove_all(h->props);
+  mock_set(h, "Present", g_variant_new_boolean(FALSE), FALSE);
+}
+
+static void mock_sim_locked(Harness *h) {
+  mock_sim_absent(h);
+  mock_set(h, "Present", g_variant_new_boolean(TRUE), FALSE);
+  mock_set(h, "CardIdentifier", g_variant_new_string("8901000000000000001"),
+           FALSE);
+  mock_set(h, "PinRequired", g_variant_new_string("pin"), FALSE);
+}
+
+static void mock_sim_unlocked(Harness *h) {
+  mock_sim_locked(h);
+  mock_set(h, "PinRequired", g_variant_new_string("none"), FALSE);
+  mock_set(h, "SubscriberIdentity", g_variant_new_string("001010123456789"),
+           FALSE);
+  mock_set(h, "MobileCountryCode", g_variant_new_string("001"), FALSE);
+  mock_set(h, "MobileNetworkCode", g_variant_new_string("01"), FALSE);
+}
+
+static void mock_name_acquired(GDBusConnection *conn, const gchar *name,
+                               gpointer user_data) {
+  Harness *h = user_data;
+
+  h->name_owned = TRUE;
+  h->name_owned_time = g_get_monotonic_time();
+}
+
+static void mock_name_lost(GDBusConnection *conn, const gchar *name,
+                           gpointer user_data) {
+  Harness *h = user_data;
+
+  h->name_owned = FALSE;
+}
+
+// Takes org.ofono and returns the time the bus confirmed it, 0 on timeout
+static gint64 mock_own(Harness *h) {
+  h->name_owned = FALSE;
+  h->owner_id = g_bus_own_name_on_connection(
+      h->conn, OFONO_SERVICE, G_BUS_NAME_OWNER_FLAGS_NONE, mock_name_acquired,
+      mock_name_lost, h, NULL);
+  harness_arm(h);
+  while (!h->name_owned && h->timeout_id)
+    g_main_context_iteration(NULL, TRUE);
+  harness_disarm(h);
+
+  if (!h->name_owned) {
+    g_printerr("Timed out waiting for %s\n", OFONO_SERVICE);
+    return 0;
+  }
+  return h->name_owned_time;
+}
+
+static void mock_unown(Harness *h) {
+  if (h->owner_id) {
+    g_bus_unown_name(h->owner_id);
+    h->owner_id = 0;
+    h->name_owned = FALSE;
+  }
+}
+
+/* ==== tunnel process ==== */
+
+static void daemon_read_line(Harness *h);
+
+static void daemon_line_ready(GObject *source, GAsyncResult *res,
+                              gpointer user_data) {
+  GError *error = NULL;
+  gchar *line = g_data_input_stream_read_line_finish(
+      G_DATA_INPUT_STREAM(source), res, NULL, &error);
+  const gint64 now = g_get_monotonic_time();
+
+  if (!line) {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      Harness *h = user_data;
+
+      h->daemon_exited = TRUE;
+      g_main_loop_quit(h->loop);
+    }
+    g_clear_error(&error);
+    return;
+  }
+
+  Harness *h = user_data;
+  if (opt_verbose)
+    g_printerr("  | %s\n", line);
+
+  for (int i = 0; i < EVENT_COUNT; i++) {
+    if (strstr(line, harness_event_text[i])) {
+      h->event_count[i]++;
+      h->event_time[i] = now;
+      if ((HarnessEvent)i == h->wait_event &&
+          h->event_count[i] >= h->wait_count)
+        g_main_loop_quit(h->loop);
+    }
+  }
+
+  g_free(line);
+  daemon_read_line(h);
+}
+
+static void daemon_read_line(Harness *h) {
+  g_data_input_stream_read_line_async(h->daemon_err, G_PRIORITY_DEFAULT,
+                                      h->daemon_cancel, daemon_line_ready, h);
+}
+
+static gboolean daemon_spawn(Harness *h) {
+  GError *error = NULL;
+  GSubprocessLauncher *launcher =
+      g_subprocess_launcher_new(G_SUBPROCESS_FLAGS_STDERR_PIPE);
+  gchar *delay = g_strdup_printf("%d", opt_delay);
+  const gchar *argv[] = {opt_daemon, "--transport", "loopback",
+                         "--loopback-delay", delay, NULL};
+
+  g_subprocess_launcher_setenv(launcher, "DBUS_SYSTEM_BUS_ADDRESS",
+                               h->address, TRUE);
+  h->daemon = g_subprocess_launcher_spawnv(launcher, argv, &error);
+  g_object_unref(launcher);
+  g_free(delay);
+
+  if (!h->daemon) {
+    g_printerr("Failed to start %s: %s\n", opt_daemon, error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  memset(h->event_count, 0, sizeof(h->event_count));
+  memset(h->event_time, 0, sizeof(h->event_time));
+  h->daemon_exited = FALSE;
+  h->daemon_cancel = g_cancellable_new();
+  h->daemon_err =
+      g_data_input_stream_new(g_subprocess_get_stderr_pipe(h->daemon));
+  daemon_read_line(h);
+  return TRUE;
+}
+
+static void daemon_stop(Harness *h) {
+  if (!h->daemon)
+    return;
+
+  g_subprocess_send_signal(h->daemon, SIGTERM);
+  g_subprocess_wait(h->daemon, NULL, NULL);
+  g_cancellable_cancel(h->daemon_cancel);
+  g_clear_object(&h->daemon_cancel);
+  g_clear_object(&h->daemon_err);
+  g_clear_object(&h->daemon);
+}
+
+// Returns time of the count-th occurrence of the event, 0 on timeout or if
+// the daemon has exited
+static gint64 harness_wait(Harness *h, HarnessEvent event, guint count) {
+  if (h->event_count[event] < count && !h->daemon_exited) {
+    h->wait_event = event;
+    h->wait_count = count;
+    harness_arm(h);
+    g_main_loop_run(h->loop);
+    harness_disarm(h);
+    h->wait_event = EVENT_COUNT;
+  }
+
+  if (h->event_count[event] >= count)
+    return h->event_time[event];
+
+  if (h->daemon_exited)
+    g_printerr("Daemon exited while waiting for \"%s\"\n",
+               harness_event_text[event]);
+  else
+    g_printerr("Timed out waiting for \"%s\"\n", harness_event_text[event]);
+  return 0;
+}
+
+static void harness_flush(Harness *h) {
+  g_dbus_connection_flush_sync(h->conn, NULL, NULL);
+}
+
+/* ==== scenarios ==== */
+
+// PIN entered on a locked card, the rest follows
+static gint64 scenario_unlock(Harness *h) {
+  mock_sim_locked(h);
+  if (!mock_own(h) || !daemon_spawn(h) ||
+      !harness_wait(h, EVENT_MONITORING, 1) ||
+      !harness_wait(h, EVENT_CALLBACKS, 1))
+    return -1;
+
+  mock_set(h, "PinRequired", g_variant_new_string("none"), TRUE);
+  mock_set(h, "SubscriberIdentity", g_variant_new_string("001010123456789"),
+           TRUE);
+  mock_set(h, "MobileCountryCode", g_variant_new_string("001"), TRUE);
+  const gint64 start = g_get_monotonic_time();
+  mock_set(h, "MobileNetworkCode", g_variant_new_string("01"), TRUE);
+  harness_flush(h);
+
+  const gint64 end = harness_wait(h, EVENT_ATEL_READY, 1);
+  return end ? end - start : -1;
+}
+
+// Card without PIN loading, all properties arrive back to back
+static gint64 scenario_burst(Harness *h) {
+  mock_sim_absent(h);
+  if (!mock_own(h) || !daemon_spawn(h) ||
+      !harness_wait(h, EVENT_MONITORING, 1) ||
+      !harness_wait(h, EVENT_CALLBACKS, 1))
+    return -1;
+
+  mock_set(h, "Present", g_variant_new_boolean(TRUE), TRUE);
+  mock_set(h, "CardIdentifier", g_variant_new_string("8901000000000000001"),
+           TRUE);
+  mock_set(h, "PinRequired", g_variant_new_string("none"), TRUE);
+  mock_set(h, "SubscriberIdentity", g_variant_new_string("001010123456789"),
+           TRUE);
+  mock_set(h, "MobileCountryCode", g_variant_new_string("001"), TRUE);
+  const gint64 start = g_get_monotonic_time();
+  mock_set(h, "MobileNetworkCode", g_variant_new_string("01"), TRUE);
+  harness_flush(h);
+
+  const gint64 end = harness_wait(h, EVENT_ATEL_READY, 1);
+  return end ? end - start : -1;
+}
+
+// oFono shows up after the binder handshake with the SIM already unlocked
+static gint64 scenario_late_ofono(Harness *h) {
+  if (!daemon_spawn(h) || !harness_wait(h, EVENT_CALLBACKS, 1))
+    return -1;
+
+  mock_sim_unlocked(h);
+  const gint64 start = mock_own(h);
+  if (!start)
+    return -1;
+
+  const gint64 end = harness_wait(h, EVENT_ATEL_READY, 1);
+  return end ? end - start : -1;
+}
+
+// oFono restarts after ATEL ready has been sent
+static gint64 scenario_ofono_restart(Harness *h) {
+  mock_sim_unlocked(h);
+  if (!mock_own(h) || !daemon_spawn(h) ||
+      !harness_wait(h, EVENT_ATEL_READY, 1))
+    return -1;
+
+  mock_unown(h);
+  if (!harness_wait(h, EVENT_OFONO_GONE, 1))
+    return -1;
+  const gint64 start = mock_own(h);
+  if (!start)
+    return -1;
+
+  const gint64 end = harness_wait(h, EVENT_ATEL_READY, 2);
+  return end ? end - start : -1;
+}
+
+static const HarnessScenario scenarios[] = {
+    {"unlock", scenario_unlock},
+    {"burst", scenario_burst},
+    {"late-ofono", scenario_late_ofono},
+    {"ofono-restart", scenario_ofono_restart},
+};
+
+/* ==== setup ==== */
+
+static gboolean harness_start_bus(Harness *h) {
+  GError *error = NULL;
+
+  h->tmpdir = g_dir_make_tmp("unlock-latency-XXXXXX", &error);
+  if (!h->tmpdir) {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  gchar *config = g_strdup_printf(bus_config, h->tmpdir);
+  h->config = g_build_filename(h->tmpdir, "bus.conf", NULL);
+  gboolean ok = g_file_set_contents(h->config, config, -1, &error);
+  g_free(config);
+  if (!ok) {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  gchar *config_arg = g_strdup_printf("--config-file=%s", h->config);
+  const gchar *argv[] = {opt_dbus_daemon, config_arg, "--nofork",
+                         "--print-address", NULL};
+  h->bus = g_subprocess_newv(argv, G_SUBPROCESS_FLAGS_STDOUT_PIPE, &error);
+  g_free(config_arg);
+  if (!h->bus) {
+    g_printerr("Failed to start %s: %s\n", opt_dbus_daemon, error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  GDataInputStream *out =
+      g_data_input_stream_new(g_subprocess_get_stdout_pipe(h->bus));
+  h->address = g_data_input_stream_read_line(out, NULL, NULL, &error);
+  g_object_unref(out);
+  if (!h->address) {
+    g_printerr("No address from %s\n", opt_dbus_daemon);
+    g_clear_error(&error);
+    return FALSE;
+  }
+
+  h->conn = g_dbus_connection_new_for_address_sync(
+      h->address,
+      G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+          G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+      NULL, NULL, &error);
+  if (!h->conn) {
+    g_printerr("Failed to connect to %s: %s\n", h->address, error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  h->node = g_dbus_node_info_new_for_xml(mock_xml, NULL);
+  h->manager_reg = g_dbus_connection_register_object(
+      h->conn, OFONO_MANAGER_PATH,
+      g_dbus_node_info_lookup_interface(h->node, OFONO_MANAGER_IFACE),
+      &mock_vtable, h, NULL, NULL);
+  h->sim_reg = g_dbus_connection_register_object(
+      h->conn, MOCK_MODEM_PATH,
+      g_dbus_node_info_lookup_interface(h->node, OFONO_SIM_MANAGER_IFACE),
+      &mock_vtable, h, NULL, NULL);
+  return TRUE;
+}
+
+static void harness_cleanup(Harness *h) {
+  daemon_stop(h);
+  mock_unown(h);
+  if (h->conn) {
+    g_dbus_connection_unregister_object(h->conn, h->manager_reg);
+    g_dbus_connection_unregister_object(h->conn, h->sim_reg);
+    g_dbus_connection_close_sync(h->conn, NULL, NULL);
+    g_object_unref(h->conn);
+  }
+  if (h->node)
+    g_dbus_node_info_unref(h->node);
+  if (h->bus) {
+    g_subprocess_send_signal(h->bus, SIGTERM);
+    g_subprocess_wait(h->bus, NULL, NULL);
+    g_object_unref(h->bus);
+  }
+  if (h->config)
+    g_unlink(h->config);
+  if (h->tmpdir)
+    g_rmdir(h->tmpdir);
+  g_free(h->config);
+  g_free(h->tmpdir);
+  g_free(h->address);
+  g_hash_table_destroy(h->props);
+  g_main_loop_unref(h->loop);
+}
+
+static int compare_gint64(gconstpointer a, gconstpointer b) {
+  const gint64 x = *(const gint64 *)a;
+  const gint64 y = *(const gint64 *)b;
+
+  return (x > y) - (x < y);
+}
+
+static gint64 percentile(GArray *samples, double q) {
+  return g_array_index(samples, gint64, (guint)((samples->len - 1) * q));
+}
+
+static void run_scenario(Harness *h, const HarnessScenario *scenario) {
+  GArray *samples = g_array_new(FALSE, FALSE, sizeof(gint64));
+  guint failed = 0;
+
+  for (int i = 0; i < opt_runs; i++) {
+    const gint64 latency = scenario->run(h);
+
+    daemon_stop(h);
+    mock_unown(h);
+    if (latency >= 0)
+      g_array_append_val(samples, latency);
+    else
+      failed++;
+  }
+
+  printf("%-14s runs=%u failed=%u", scenario->name, samples->len, failed);
+  if (samples->len) {
+    g_array_sort(samples, compare_gint64);
+    printf(" p50=%" G_GINT64_FORMAT "us p90=%" G_GINT64_FORMAT
+           "us p99=%" G_GINT64_FORMAT "us max=%" G_GINT64_FORMAT "us",
+           percentile(samples, 0.5), percentile(samples, 0.9),
+           percentile(samples, 0.99), percentile(samples, 1.0));
+  }
+  printf("\n");
+  fflush(stdout);
+  g_array_free(samples, TRUE);
+}
+
+int main(int argc, char *argv[]) {
+  GError *error = NULL;
+  GOptionContext *context =
+      g_option_context_new("- unlock to ATEL ready latency harness");
+  Harness h;
+  int ret = 0;
+
+  g_option_context_add_main_entries(context, option_entries, NULL);
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("Option parsing failed: %s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return 1;
+  }
+  g_option_context_free(context);
+
+  if (opt_runs <= 0) {
+    g_printerr("Invalid number of runs: %d\n", opt_runs);
+    return 1;
+  }
+
+  memset(&h, 0, sizeof(h));
+  h.loop = g_main_loop_new(NULL, FALSE);
+  h.props = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                  (GDestroyNotify)g_variant_unref);
+  h.wait_event = EVENT_COUNT;
+
+  if (harness_start_bus(&h)) {
+    gboolean found = FALSE;
+
+    for (guint i = 0; i < G_N_ELEMENTS(scenarios); i++) {
+      if (!opt_scenario || !strcmp(opt_scenario, scenarios[i].name)) {
+        run_scenario(&h, scenarios + i);
+        found = TRUE;
+      }
+    }
+    if (!found) {
+      g_printerr("Unknown scenario: %s\n", opt_scenario);
+      ret = 1;
+    }
+  } else {
+    ret = 1;
+  }
+
+  harness_cleanup(&h);
+  return ret;
+}